@@ -0,0 +1,124 @@
+#include "aesctr.h"
+#include <cstring>
+#include <stdexcept>
+#include <sys/random.h>
+
+#ifndef __AES__
+#error "aesctr requires AES-NI, build with -maes or -march=native"
+#endif
+
+static const int AES_STREAM_PARALLEL = 8;
+
+static inline __m128i expand_step(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+// key expansion is ten aeskeygenassist steps, so re-seeding costs less than one block of output
+void aes_stream_seed(aes_stream &s, const unsigned char seed[AES_STREAM_SEED_SIZE])
+{
+    __m128i *rk = s.round_keys;
+    rk[0] = _mm_loadu_si128((const __m128i *)seed);
+    rk[1] = expand_step(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+    rk[2] = expand_step(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+    rk[3] = expand_step(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+    rk[4] = expand_step(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+    rk[5] = expand_step(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+    rk[6] = expand_step(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+    rk[7] = expand_step(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+    rk[8] = expand_step(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+    rk[9] = expand_step(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+    rk[10] = expand_step(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+    s.counter = _mm_loadu_si128((const __m128i *)(seed + 16));
+}
+
+void aes_stream_seed_random(aes_stream &s)
+{
+    unsigned char seed[AES_STREAM_SEED_SIZE];
+    size_t got = 0;
+    while (got < sizeof(seed)) {
+        ssize_t r = getrandom(seed + got, sizeof(seed) - got, 0);
+        if (r < 0) {
+            throw new std::runtime_error("getrandom failed");
+        }
+        got += r;
+    }
+    aes_stream_seed(s, seed);
+    memset(seed, 0, sizeof(seed));
+}
+
+void aes_stream_seed_deterministic(aes_stream &s, uint64_t seed, uint64_t stream_id)
+{
+    unsigned char bytes[AES_STREAM_SEED_SIZE] = {0};
+    memcpy(bytes, &seed, sizeof(seed));
+    memcpy(bytes + 8, &stream_id, sizeof(stream_id));
+    aes_stream_seed(s, bytes);
+}
+
+static inline __m128i encrypt_counter(const aes_stream &s, __m128i block)
+{
+    block = _mm_xor_si128(block, s.round_keys[0]);
+    for(int r = 1; r < 10; r++)
+    {
+        block = _mm_aesenc_si128(block, s.round_keys[r]);
+    }
+    return _mm_aesenclast_si128(block, s.round_keys[10]);
+}
+
+// the low 64 bits of the counter block are incremented as a little-endian integer
+void aes_stream_fill(aes_stream &s, unsigned char * out, size_t len)
+{
+    const __m128i one = _mm_set_epi64x(0, 1);
+
+    // independent blocks keep the aesenc pipeline full
+    while (len >= 16 * AES_STREAM_PARALLEL) {
+        __m128i b[AES_STREAM_PARALLEL];
+        for(int i = 0; i < AES_STREAM_PARALLEL; i++)
+        {
+            b[i] = _mm_xor_si128(s.counter, s.round_keys[0]);
+            s.counter = _mm_add_epi64(s.counter, one);
+        }
+        for(int r = 1; r < 10; r++)
+        {
+            for(int i = 0; i < AES_STREAM_PARALLEL; i++)
+            {
+                b[i] = _mm_aesenc_si128(b[i], s.round_keys[r]);
+            }
+        }
+        for(int i = 0; i < AES_STREAM_PARALLEL; i++)
+        {
+            _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(b[i], s.round_keys[10]));
+            out += 16;
+        }
+        len -= 16 * AES_STREAM_PARALLEL;
+    }
+
+    while (len > 0) {
+        __m128i b = encrypt_counter(s, s.counter);
+        s.counter = _mm_add_epi64(s.counter, one);
+        size_t n = len < 16 ? len : 16;
+        if (n == 16) {
+            _mm_storeu_si128((__m128i *)out, b);
+        } else {
+            unsigned char tmp[16];
+            _mm_storeu_si128((__m128i *)tmp, b);
+            memcpy(out, tmp, n);
+        }
+        out += n;
+        len -= n;
+    }
+}
+
+secp256k1_scalar aes_stream_scalar(aes_stream &s)
+{
+    secp256k1_scalar zero = secp256k1_scalar();
+    secp256k1_scalar res;
+    do {
+        aes_stream_fill(s, (unsigned char *)res.d, sizeof(res.d));
+    } while (res >= SECP256K1_ORDER || res == zero);
+    return res;
+}
@@ -0,0 +1,30 @@
+#include <cstdint>
+#include <cstddef>
+#include <wmmintrin.h>
+#include "secp256k1.h"
+
+#ifndef AESCTR_H
+#define AESCTR_H
+
+// AES-128 in counter mode on AES-NI, used as a CSPRNG for seed scalars.
+// One instance per thread, instances are not shared.
+// A seed is 16 bytes of key followed by the 16 byte initial counter block.
+const int AES_STREAM_SEED_SIZE = 32;
+
+struct aes_stream
+{
+    __m128i round_keys[11];
+    __m128i counter;
+};
+
+void aes_stream_seed(aes_stream &s, const unsigned char seed[AES_STREAM_SEED_SIZE]);
+void aes_stream_seed_random(aes_stream &s);
+// reproducible streams for benchmarks, stream_id separates threads
+void aes_stream_seed_deterministic(aes_stream &s, uint64_t seed, uint64_t stream_id);
+
+void aes_stream_fill(aes_stream &s, unsigned char * out, size_t len);
+
+// uniform in [1, n) by rejection, the rejection rate is about 2^-128
+secp256k1_scalar aes_stream_scalar(aes_stream &s);
+
+#endif
@@ -0,0 +1,70 @@
+#include "arena.h"
+#include <atomic>
+#include <stdexcept>
+#include <sys/mman.h>
+
+static std::atomic<bool> use_hugetlb{false};
+
+void arena_use_hugetlb(bool enable)
+{
+    use_hugetlb = enable;
+}
+
+void arena_init(arena &a, size_t bytes)
+{
+    arena_release(a);
+    size_t size = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size == 0) {
+        return;
+    }
+
+    void * m = MAP_FAILED;
+    bool huge = size >= ARENA_HUGE_PAGE;
+    if (huge && use_hugetlb) {
+        size_t rounded = (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+        m = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (m != MAP_FAILED) {
+            size = rounded;
+            a.hugetlb = true;
+        }
+    }
+    if (m == MAP_FAILED) {
+        m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) {
+            throw new std::runtime_error("Could not map the batch arena");
+        }
+        if (huge) {
+            madvise(m, size, MADV_HUGEPAGE);
+        }
+    }
+    a.base = (unsigned char *)m;
+    a.size = size;
+    a.used = 0;
+}
+
+void arena_release(arena &a)
+{
+    if (a.base) {
+        munmap(a.base, a.size);
+    }
+    a.base = nullptr;
+    a.size = 0;
+    a.used = 0;
+    a.hugetlb = false;
+}
+
+void * arena_alloc(arena &a, size_t bytes)
+{
+    size_t n = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (n > a.size - a.used) {
+        throw new std::runtime_error("Batch arena is exhausted");
+    }
+    void * p = a.base + a.used;
+    a.used += n;
+    return p;
+}
+
+arena::~arena()
+{
+    arena_release(*this);
+}
@@ -0,0 +1,48 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+// Bump allocator over one mapping, reserved once per thread and reused for the
+// whole search. Every allocation is 64 byte aligned. Mappings of 2 MB and more
+// are asked for transparent huge pages, and with arena_use_hugetlb(true) for
+// explicit MAP_HUGETLB pages first, which falls back quietly when none are reserved.
+const size_t ARENA_ALIGN = 64;
+const size_t ARENA_HUGE_PAGE = (size_t)2 << 20;
+
+struct arena
+{
+    unsigned char * base;
+    size_t size;
+    size_t used;
+    bool hugetlb;
+
+    arena() : base(nullptr), size(0), used(0), hugetlb(false) {}
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+    ~arena();
+};
+
+void arena_use_hugetlb(bool enable);
+
+void arena_init(arena &a, size_t bytes);
+void arena_release(arena &a);
+// throws when the arena is exhausted, the hot loop never allocates
+void * arena_alloc(arena &a, size_t bytes);
+
+// room for n objects of T including alignment padding, to size arena_init
+template<typename T>
+size_t arena_bytes(size_t n)
+{
+    return (n * sizeof(T) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// trivially constructible types only, the memory is zero filled
+template<typename T>
+T * arena_array(arena &a, size_t n)
+{
+    return (T *)arena_alloc(a, n * sizeof(T));
+}
+
+#endif
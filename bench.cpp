@@ -0,0 +1,429 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <x86intrin.h>
+#include "secp256k1.h"
+#include "blockmath.h"
+#include "keccak.h"
+#include "ethaddress.h"
+#include "create2.h"
+#include "keysearch.h"
+#include "aesctr.h"
+#include "search.h"
+#include "sha256.h"
+#include "taproot.h"
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Microbenchmarks for every layer plus end-to-end keys/s.
+// Every result is reported as ns/op (lower is better, throughput entries are
+// converted to ns per key) so the regression gate can treat them uniformly.
+
+struct bench_result
+{
+    std::string name;
+    double ns_per_op;
+    double cycles_per_op;
+};
+
+template<typename T>
+static inline void do_not_optimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static void pin_to_core(int core)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % std::thread::hardware_concurrency(), &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Runs f in a loop long enough to take ~min_seconds after a warm-up,
+// reports the best of a few repetitions.
+template<typename F>
+static bench_result run_kernel(const std::string &name, F f, double min_seconds)
+{
+    typedef std::chrono::steady_clock clock;
+
+    uint64_t iters = 1;
+    for(;;)
+    {
+        auto t0 = clock::now();
+        for(uint64_t i = 0; i < iters; i++) f();
+        double s = std::chrono::duration<double>(clock::now() - t0).count();
+        if (s > min_seconds / 4) {
+            iters = (uint64_t)(iters * (min_seconds / s)) + 1;
+            break;
+        }
+        iters *= 4;
+    }
+
+    bench_result best = {name, 1e30, 1e30};
+    for(int rep = 0; rep < 7; rep++)
+    {
+        auto t0 = clock::now();
+        uint64_t c0 = __rdtsc();
+        for(uint64_t i = 0; i < iters; i++) f();
+        uint64_t c1 = __rdtsc();
+        double s = std::chrono::duration<double>(clock::now() - t0).count();
+
+        double ns = s * 1e9 / iters;
+        if (ns < best.ns_per_op) {
+            best.ns_per_op = ns;
+            best.cycles_per_op = (double)(c1 - c0) / iters;
+        }
+    }
+    return best;
+}
+
+static bench_result run_keysearch(int nthreads, size_t batch, double seconds)
+{
+    std::vector<secp256k1_point> table(batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, batch);
+    // 40 nibbles, never matches in practice
+    eth_pattern p = eth_pattern_compile(std::string(40, '0'), false);
+
+    search_control ctl;
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = __rdtsc();
+    std::thread timer([&]() {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        ctl.stop = true;
+    });
+
+    search_run(nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        pin_to_core(worker);
+        aes_stream rng;
+        aes_stream_seed_deterministic(rng, 1, worker);
+        keysearch_walker w;
+        keysearch_walker_init(w, table.data(), batch);
+        keysearch_hit hit;
+        secp256k1_point start = double_and_add(aes_stream_scalar(rng), SECP256K1_GENERATOR);
+        keysearch_walk(w, start, p, ctl, UINT64_MAX, hit);
+    });
+    timer.join();
+
+    uint64_t c1 = __rdtsc();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t keys = ctl.attempts;
+    bench_result res;
+    res.name = "keysearch_t" + std::to_string(nthreads);
+    res.ns_per_op = s * 1e9 / keys;
+    res.cycles_per_op = (double)(c1 - c0) / keys;
+    return res;
+}
+
+struct bench_case
+{
+    std::string name;
+    std::function<bench_result()> run;
+};
+
+// inputs shared by the kernels, kept alive for re-runs of suspected regressions
+struct bench_fixture
+{
+    static const size_t n = 256;
+    secp256k1_scalar a, b;
+    secp256k1_mult_result ab;
+    secp256k1_point pa;
+    secp256k1_point_jacobian ja;
+    std::vector<secp256k1_point_jacobian> jac;
+    std::vector<secp256k1_point> aff, table;
+    std::vector<secp256k1_scalar> scratch, privs;
+    std::vector<secp256k1_key_uncompressed> keys;
+    std::vector<secp256k1_key_compressed> pubs;
+    uint64_t st[25][KECCAK_LANES];
+    create2_state cs;
+    eth_address lanes[KECCAK_LANES];
+    uint64_t counter;
+    eth_pattern nibbles, checksum;
+    eth_address addr;
+    unsigned char hash[32];
+    uint32_t tag_in[8][SHA256_LANES], tag_out[8][SHA256_LANES];
+    taproot_pattern taproot;
+    taproot_walker walker;
+};
+
+static void fixture_init(bench_fixture &f)
+{
+    aes_stream rng;
+    aes_stream_seed_deterministic(rng, 1, 0);
+    f.a = aes_stream_scalar(rng);
+    f.b = aes_stream_scalar(rng);
+    f.ab = mult(f.a, f.b);
+    f.pa = double_and_add(f.a, SECP256K1_GENERATOR);
+    f.ja = jacobian_double(jacobian_from_affine(f.pa));
+
+    f.jac.resize(f.n);
+    f.aff.resize(f.n);
+    f.table.resize(f.n);
+    f.scratch.resize(2 * f.n);
+    f.keys.resize(f.n);
+    f.privs.resize(f.n);
+    f.pubs.resize(f.n);
+    for(size_t i = 0; i < f.n; i++) f.privs[i] = aes_stream_scalar(rng);
+    point_multiples(f.table.data(), SECP256K1_GENERATOR, f.n);
+    f.jac[0] = f.ja;
+    for(size_t i = 1; i < f.n; i++) f.jac[i] = jacobian_add_affine(f.jac[i-1], SECP256K1_GENERATOR);
+    point_add_batch(f.aff.data(), f.pa, f.table.data(), f.n, f.scratch.data());
+    serialize_uncompressed(f.keys.data(), f.aff.data(), f.n);
+
+    memset(f.st, 0, sizeof(f.st));
+    f.cs = create2_prepare(create2_job());
+    f.counter = 0;
+    f.nibbles = eth_pattern_compile("0xdeadbeef", false);
+    f.checksum = eth_pattern_compile("0xDeAdBeEf", true);
+    keccak256(f.hash, f.keys[0].bytes + 1, 64);
+    memcpy(f.addr.bytes, f.hash + 12, ETH_ADDRESS_SIZE);
+
+    for(int i = 0; i < 8; i++)
+    {
+        for(int l = 0; l < SHA256_LANES; l++) f.tag_in[i][l] = f.aff[l].x.d[i];
+    }
+    // all 51 characters, never matches in practice
+    f.taproot = taproot_pattern_compile(std::string(TAPROOT_PATTERN_MAX_CHARS, 'q'));
+    taproot_walker_init(f.walker, f.table.data(), f.n);
+}
+
+template<typename F>
+static bench_case kernel(const std::string &name, double seconds, size_t per_call, F f)
+{
+    return {name, [=]() {
+        bench_result r = run_kernel(name, f, seconds);
+        r.ns_per_op /= per_call;
+        r.cycles_per_op /= per_call;
+        return r;
+    }};
+}
+
+static std::vector<bench_case> all_cases(bench_fixture &f, double s, int max_threads)
+{
+    const size_t n = f.n;
+    std::vector<bench_case> cases = {
+        kernel("blockwise_mult", s, 1, [&f]() {
+            uint32_t res[16] = {0};
+            blockwise_mult(res, f.a.d, f.b.d, 8);
+            do_not_optimize(res);
+        }),
+        kernel("mult", s, 1, [&f]() { do_not_optimize(mult(f.a, f.b)); }),
+        kernel("mult_ct", s, 1, [&f]() { do_not_optimize(mult<const_time>(f.a, f.b)); }),
+        kernel("reduce", s, 1, [&f]() { do_not_optimize(reduce(f.ab)); }),
+        kernel("reduce_ct", s, 1, [&f]() { do_not_optimize(reduce<const_time>(f.ab)); }),
+        kernel("fastreduce", s, 1, [&f]() { do_not_optimize(fastreduce(f.ab)); }),
+        kernel("fastreduce_ct", s, 1, [&f]() { do_not_optimize(fastreduce<const_time>(f.ab)); }),
+        kernel("modinv", s, 1, [&f]() { do_not_optimize(modinv(f.ab)); }),
+        kernel("modinv_ct", s, 1, [&f]() { do_not_optimize(modinv<const_time>(f.ab)); }),
+        kernel("jacobian_add_affine", s, 1, [&f]() {
+            do_not_optimize(jacobian_add_affine(f.ja, SECP256K1_GENERATOR));
+        }),
+        kernel("jacobian_add_affine_ct", s, 1, [&f]() {
+            do_not_optimize(jacobian_add_affine<const_time>(f.ja, SECP256K1_GENERATOR));
+        }),
+        kernel("jacobian_double", s, 1, [&f]() { do_not_optimize(jacobian_double(f.ja)); }),
+        kernel("jacobian_double_ct", s, 1, [&f]() { do_not_optimize(jacobian_double<const_time>(f.ja)); }),
+        kernel("batch_to_affine_per_point", s, n, [&f]() {
+            jacobian_batch_to_affine(f.aff.data(), f.jac.data(), f.n, f.scratch.data());
+            do_not_optimize(f.aff[0]);
+        }),
+        kernel("point_add_batch_per_point", s, n, [&f]() {
+            point_add_batch(f.aff.data(), f.pa, f.table.data(), f.n, f.scratch.data());
+            do_not_optimize(f.aff[0]);
+        }),
+        kernel("double_and_add", s, 1, [&f]() { do_not_optimize(double_and_add(f.a, SECP256K1_GENERATOR)); }),
+        kernel("double_and_add_ct", s, 1, [&f]() {
+            do_not_optimize(double_and_add<const_time>(f.a, SECP256K1_GENERATOR));
+        }),
+        kernel("generator_mult", s, 1, [&f]() { do_not_optimize(generator_mult(f.a)); }),
+        kernel("generator_mult_ct", s, 1, [&f]() { do_not_optimize(generator_mult<const_time>(f.a)); }),
+        kernel("derive_pubkeys_per_key", s, n, [&f]() {
+            derive_pubkeys_compressed(f.pubs.data(), f.privs.data(), f.n, 1);
+            do_not_optimize(f.pubs[0]);
+        }),
+        kernel("generator_mult_add_batch_per_key", s, n, [&f]() {
+            generator_mult_add_batch(f.aff.data(), f.table.data(), f.privs.data(), f.n, f.jac.data(), f.scratch.data());
+            do_not_optimize(f.aff[0]);
+        }),
+        kernel("serialize_uncompressed_per_point", s, n, [&f]() {
+            serialize_uncompressed(f.keys.data(), f.aff.data(), f.n);
+            do_not_optimize(f.keys[0]);
+        }),
+        kernel("keccak256_64B", s, 1, [&f]() {
+            keccak256(f.hash, f.keys[0].bytes + 1, 64);
+            do_not_optimize(f.hash);
+        }),
+        kernel("keccakf1600_x4_per_lane", s, KECCAK_LANES, [&f]() {
+            keccakf1600_x4(f.st);
+            do_not_optimize(f.st);
+        }),
+        kernel("create2_per_salt", s, KECCAK_LANES, [&f]() {
+            create2_address_x4(f.lanes, f.cs, f.counter);
+            f.counter += KECCAK_LANES;
+            do_not_optimize(f.lanes);
+        }),
+        kernel("sha256_tagged32_x8_per_lane", s, SHA256_LANES, [&f]() {
+            sha256_tagged32_x8(f.tag_out, taproot_tweak_midstate(), f.tag_in);
+            do_not_optimize(f.tag_out);
+        }),
+        kernel("taproot_walk_per_key", s, n, [&f]() {
+            search_control ctl;
+            taproot_hit hit;
+            taproot_walk(f.walker, f.pa, f.taproot, ctl, f.n, hit);
+            do_not_optimize(hit);
+        }),
+        kernel("eth_match", s, 1, [&f]() { do_not_optimize(eth_match(f.nibbles, f.addr)); }),
+        kernel("eth_match_checksum", s, 1, [&f]() {
+            do_not_optimize(eth_match_checksum(f.checksum, f.addr));
+        }),
+    };
+
+    for(int t = 1; t <= max_threads; t++)
+    {
+        cases.push_back({"keysearch_t" + std::to_string(t), [=]() { return run_keysearch(t, 256, s * 4); }});
+    }
+    return cases;
+}
+
+static void write_json(std::ostream &out, const std::vector<bench_result> &results)
+{
+    out << "{\n  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"cycles_per_op\": %.1f}%s\n",
+            results[i].name.c_str(), results[i].ns_per_op, results[i].cycles_per_op,
+            i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+// only reads the format written by write_json
+static std::map<std::string, double> read_baseline(const std::string &path)
+{
+    std::map<std::string, double> res;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        char name[128];
+        double ns;
+        const char * p = strstr(line.c_str(), "{\"name\"");
+        if (p && sscanf(p, "{\"name\": \"%127[^\"]\", \"ns_per_op\": %lf", name, &ns) == 2) {
+            res[name] = ns;
+        }
+    }
+    return res;
+}
+
+static void usage()
+{
+    cerr << "usage: benchmark [--out file] [--baseline file] [--threshold percent]" << endl;
+    cerr << "                 [--min-delta ns] [--seconds s] [--threads n]" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string out_path;
+    std::string baseline_path;
+    double threshold = 25.0;
+    // differences below this are timer and frequency noise on the tiniest kernels
+    double min_delta_ns = 2.0;
+    double seconds = 0.2;
+    int max_threads = std::thread::hardware_concurrency();
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = std::stod(argv[++i]);
+        } else if (arg == "--min-delta" && i + 1 < argc) {
+            min_delta_ns = std::stod(argv[++i]);
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::stod(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            max_threads = std::stoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    pin_to_core(0);
+    bench_fixture fixture;
+    fixture_init(fixture);
+    std::vector<bench_case> cases = all_cases(fixture, seconds, max_threads > 0 ? max_threads : 1);
+
+    std::vector<bench_result> results;
+    for(const bench_case &c : cases)
+    {
+        results.push_back(c.run());
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty()) {
+        baseline = read_baseline(baseline_path);
+        if (baseline.empty()) {
+            cerr << "no baseline results in " << baseline_path << endl;
+            return 2;
+        }
+    }
+
+    // a suspected regression is measured again before it fails the run,
+    // a single slow sample is more often a noisy neighbour than a real change
+    const int retries = 2;
+    std::vector<std::string> regressions;
+    char line[256];
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        bench_result &r = results[i];
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            continue;
+        }
+        auto change = [&]() { return 100.0 * (r.ns_per_op - it->second) / it->second; };
+        auto regressed = [&]() { return change() > threshold && r.ns_per_op - it->second > min_delta_ns; };
+
+        for(int k = 0; k < retries && regressed(); k++)
+        {
+            bench_result again = cases[i].run();
+            if (again.ns_per_op < r.ns_per_op) {
+                r = again;
+            }
+        }
+        if (regressed()) {
+            snprintf(line, sizeof(line), "REGRESSION %s: %.2f -> %.2f ns/op (+%.1f%%)", r.name.c_str(), it->second, r.ns_per_op, change());
+            regressions.push_back(line);
+        }
+    }
+
+    for(const bench_result &r : results)
+    {
+        snprintf(line, sizeof(line), "%-36s %12.2f ns/op %12.1f cycles/op", r.name.c_str(), r.ns_per_op, r.cycles_per_op);
+        cout << line << endl;
+    }
+    for(const std::string &r : regressions)
+    {
+        cerr << r << endl;
+    }
+
+    if (!out_path.empty()) {
+        std::ofstream out(out_path);
+        write_json(out, results);
+    }
+    return regressions.empty() ? 0 : 1;
+}
@@ -4,19 +4,19 @@
 #include <iostream>
 
 
+// Looks at every block whatever the value: the count of the leading zero blocks
+// and the clz of the first nonzero one are both kept by mask.
 int blockwise_lzcount(const uint32_t * a, int nblocks)
 {
-    int idx = 0;
     int lzc = 0;
-    while (a[idx] == 0 && idx < nblocks) {
-        lzc += sizeof(uint32_t)*8;
-        idx++;
-    }
-    if (idx < nblocks) {
-        return lzc + __builtin_clz(a[idx]);
-    } else {
-        return lzc;
+    uint32_t seen = 0;
+    for(int i = 0; i < nblocks; i++)
+    {
+        uint32_t nonzero = 0u - ((a[i] | (0u - a[i])) >> 31);
+        lzc += (32 & ~seen & ~nonzero) + (__builtin_clz(a[i] | 1) & nonzero & ~seen);
+        seen |= nonzero;
     }
+    return lzc;
 }
 
 int blockwise_cmp(const uint32_t * a, const uint32_t * b, int nblocks)
@@ -34,10 +34,11 @@ int blockwise_cmp(const uint32_t * a, const uint32_t * b, int nblocks)
     return 0;
 }
 
+// The shifts, add and sub work in place without a temporary copy, so that the
+// callers in the hot loops do no stack allocation per call. When add or sub
+// throw, a holds the wrapped result.
 void blockwise_shl(uint32_t * a, uint32_t k, int nblocks)
 {
-    uint32_t res[nblocks] = {0};
-    std::copy(a, a + nblocks, res);
     int blocksize = sizeof(*a) * 8;
 
     if (k > nblocks*blocksize) {
@@ -47,39 +48,32 @@ void blockwise_shl(uint32_t * a, uint32_t k, int nblocks)
     int blockshifts = k/blocksize;
     int rest = k - blockshifts * blocksize;
 
-    // first shift entire blocks if possible
+    // first shift entire blocks if possible, reading ahead of what is written
     if (blockshifts) {
         for(int i = 0; i < nblocks; i++) {
             if (i + blockshifts < nblocks) {
-                res[i] = a[i + blockshifts];
+                a[i] = a[i + blockshifts];
             } else {
-                res[i] = 0;
+                a[i] = 0;
             }
         }
     }
-    
 
     // then do smaller adjustments
     if (rest) {
         for(int i = 0; i < nblocks; i++) {
             if (i < nblocks - 1) {
-                res[i] <<= rest;
-                res[i] |= (res[i+1] >> (blocksize-rest));
+                a[i] <<= rest;
+                a[i] |= (a[i+1] >> (blocksize-rest));
             } else {
-                res[i] <<= rest;
+                a[i] <<= rest;
             }
         }
     }
-    
-    for(int i = 0; i < nblocks; i++) {
-        a[i] = res[i];
-    }
 }
 
 void blockwise_shr(uint32_t * a, uint32_t k, int nblocks)
 {
-    uint32_t res[nblocks] = {0};
-    std::copy(a, a + nblocks, res);
     int blocksize = sizeof(*a) * 8;
 
     if (k > nblocks*blocksize) {
@@ -88,14 +82,14 @@ void blockwise_shr(uint32_t * a, uint32_t k, int nblocks)
 
     int blockshifts = k/blocksize;
     int rest = k - blockshifts * blocksize;
-    
-    // first shift entire blocks if possible
+
+    // first shift entire blocks if possible, reading behind what is written
     if (blockshifts) {
         for(int i = nblocks - 1; i >= 0; i--) {
             if (i - blockshifts >= 0) {
-                res[i] = a[i - blockshifts];
+                a[i] = a[i - blockshifts];
             } else {
-                res[i] = 0;
+                a[i] = 0;
             }
         }
     }
@@ -104,30 +98,26 @@ void blockwise_shr(uint32_t * a, uint32_t k, int nblocks)
     if (rest) {
         for(int i = nblocks - 1; i >= 0; i--) {
             if (i > 0) {
-                res[i] >>= rest;
-                res[i] |= (res[i-1] << (blocksize-rest));
+                a[i] >>= rest;
+                a[i] |= (a[i-1] << (blocksize-rest));
             } else {
-                res[i] >>= rest;
+                a[i] >>= rest;
             }
         }
     }
-    
-    for(int i = 0; i < nblocks; i++) {
-        a[i] = res[i];
-    }
 }
 
 void blockwise_sub(uint32_t * a, const uint32_t * b, int nblocks)
 {
-    uint32_t res[nblocks] = {0};
-    std::copy(a, a + nblocks, res);
     uint32_t carry = 0;
     for(int i = nblocks-1; i >= 0 ; i--)
     {
-        res[i] -= b[i] + carry;
-        if (carry == 1 && a[i] - b[i] - carry >= a[i]) {
+        uint32_t ai = a[i];
+        uint32_t bi = b[i];
+        a[i] = ai - (bi + carry);
+        if (carry == 1 && ai - bi - carry >= ai) {
             // underflow
-        } else if (a[i] - b[i] > a[i]) {
+        } else if (ai - bi > ai) {
             // underflow
             carry = 1;
         } else {
@@ -138,24 +128,19 @@ void blockwise_sub(uint32_t * a, const uint32_t * b, int nblocks)
             throw new std::runtime_error("Subtraction underflow");
         }
     }
-
-    for(int i = 0; i < nblocks; i++)
-    {
-        a[i] = res[i];
-    }
 }
 
 void blockwise_add(uint32_t * a, const uint32_t * b, int nblocks)
 {
-    uint32_t res[nblocks] = {0};
-    std::copy(a, a + nblocks, res);
     uint32_t carry = 0;
     for(int i = nblocks-1; i >= 0; i--)
     {
-        res[i] += b[i] + carry;
-        if (carry == 1 && a[i] + b[i] + carry <= a[i]) {
+        uint32_t ai = a[i];
+        uint32_t bi = b[i];
+        a[i] = ai + bi + carry;
+        if (carry == 1 && ai + bi + carry <= ai) {
             // overflow
-        } else if (a[i] + b[i] < a[i]) {
+        } else if (ai + bi < ai) {
             // overflow
             carry = 1;
         } else {
@@ -166,11 +151,6 @@ void blockwise_add(uint32_t * a, const uint32_t * b, int nblocks)
             throw new std::runtime_error("Addition overflow");
         }
     }
-
-    for(int i = 0; i < nblocks; i++)
-    {
-        a[i] = res[i];
-    }
 }
 
 
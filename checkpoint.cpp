@@ -0,0 +1,279 @@
+#include "checkpoint.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+static const char CHECKPOINT_MAGIC[8] = {'E', 'C', 'V', 'C', 'K', 'P', 'T', '1'};
+
+uint64_t checkpoint_hash(uint64_t h, const void * data, size_t len)
+{
+    const unsigned char * d = (const unsigned char *)data;
+    for(size_t i = 0; i < len; i++)
+    {
+        h ^= d[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t checkpoint_hash_pattern(uint64_t h, const eth_pattern &p)
+{
+    h = checkpoint_hash(h, p.value, sizeof(p.value));
+    h = checkpoint_hash(h, p.mask, sizeof(p.mask));
+    h = checkpoint_hash(h, &p.nnibbles, sizeof(p.nnibbles));
+    h = checkpoint_hash(h, &p.case_care, sizeof(p.case_care));
+    return checkpoint_hash(h, &p.case_upper, sizeof(p.case_upper));
+}
+
+static void put_u64(std::vector<unsigned char> &out, uint64_t v)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        out.push_back(v >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const unsigned char * in)
+{
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | in[i];
+    }
+    return v;
+}
+
+// magic, search hash, extra, worker count, then per worker the base as
+// 32 big-endian bytes and steps, draws and attempts as little-endian u64
+static const size_t CHECKPOINT_HEADER_SIZE = 8 + 8 + 32 + 8;
+static const size_t CHECKPOINT_WORKER_SIZE = 32 + 3 * 8;
+
+bool checkpoint_load(checkpoint &c, const std::string &path)
+{
+    FILE * f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    if (data.size() < CHECKPOINT_HEADER_SIZE || memcmp(data.data(), CHECKPOINT_MAGIC, 8) != 0) {
+        throw new std::runtime_error("Not a checkpoint file");
+    }
+    // bounded by the file size first, a forged count must not wrap the product
+    uint64_t nworkers = get_u64(data.data() + 48);
+    if (nworkers == 0 || nworkers > (data.size() - CHECKPOINT_HEADER_SIZE) / CHECKPOINT_WORKER_SIZE
+        || data.size() != CHECKPOINT_HEADER_SIZE + nworkers * CHECKPOINT_WORKER_SIZE) {
+        throw new std::runtime_error("Truncated checkpoint file");
+    }
+
+    c.search_hash = get_u64(data.data() + 8);
+    memcpy(c.extra, data.data() + 16, 32);
+    c.workers.resize(nworkers);
+    const unsigned char * p = data.data() + CHECKPOINT_HEADER_SIZE;
+    for(checkpoint_worker &w : c.workers)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            w.base.d[i] = ((uint32_t)p[4*i] << 24) | ((uint32_t)p[4*i + 1] << 16) | ((uint32_t)p[4*i + 2] << 8) | p[4*i + 3];
+        }
+        w.steps = get_u64(p + 32);
+        w.draws = get_u64(p + 40);
+        w.attempts = get_u64(p + 48);
+        p += CHECKPOINT_WORKER_SIZE;
+    }
+    return true;
+}
+
+// the rename is only durable once the directory entry is on disk
+static void sync_parent_dir(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw new std::runtime_error("Could not open the checkpoint directory");
+    }
+    int r = fsync(fd);
+    close(fd);
+    if (r != 0) {
+        throw new std::runtime_error("Could not sync the checkpoint directory");
+    }
+}
+
+// written to a temporary file, synced, renamed and the directory synced, so a
+// crash leaves either the old or the new checkpoint. The bases are secret, the file is 0600.
+void checkpoint_save(const checkpoint &c, const std::string &path)
+{
+    std::vector<unsigned char> data(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 8);
+    put_u64(data, c.search_hash);
+    data.insert(data.end(), c.extra, c.extra + 32);
+    put_u64(data, c.workers.size());
+    for(const checkpoint_worker &w : c.workers)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            for(int b = 3; b >= 0; b--)
+            {
+                data.push_back(w.base.d[i] >> (8 * b));
+            }
+        }
+        put_u64(data, w.steps);
+        put_u64(data, w.draws);
+        put_u64(data, w.attempts);
+    }
+
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw new std::runtime_error("Could not create checkpoint file");
+    }
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t w = write(fd, data.data() + off, data.size() - off);
+        if (w < 0) {
+            close(fd);
+            throw new std::runtime_error("Could not write checkpoint file");
+        }
+        off += w;
+    }
+    if (fsync(fd) != 0) {
+        close(fd);
+        throw new std::runtime_error("Could not sync checkpoint file");
+    }
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        throw new std::runtime_error("Could not replace checkpoint file");
+    }
+    sync_parent_dir(path);
+}
+
+void checkpoint_publish(checkpoint_publisher &pub, int worker, const checkpoint_worker &state)
+{
+    checkpoint_slot &s = pub.slots[worker];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for(int i = 0; i < 8; i++)
+    {
+        s.base[i].store(state.base.d[i], std::memory_order_relaxed);
+    }
+    s.steps.store(state.steps, std::memory_order_relaxed);
+    s.draws.store(state.draws, std::memory_order_relaxed);
+    s.attempts.store(state.attempts, std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+}
+
+static checkpoint_worker read_slot(const checkpoint_slot &s)
+{
+    checkpoint_worker w;
+    for(;;)
+    {
+        uint32_t before = s.seq.load(std::memory_order_acquire);
+        for(int i = 0; i < 8; i++)
+        {
+            w.base.d[i] = s.base[i].load(std::memory_order_relaxed);
+        }
+        w.steps = s.steps.load(std::memory_order_relaxed);
+        w.draws = s.draws.load(std::memory_order_relaxed);
+        w.attempts = s.attempts.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = s.seq.load(std::memory_order_relaxed);
+        if (before == after && (before & 1) == 0) {
+            return w;
+        }
+    }
+}
+
+bool checkpoint_resume(const checkpoint_publisher * pub, int worker, checkpoint_worker &state)
+{
+    if (!pub || !pub->resumed) {
+        return false;
+    }
+    if (worker >= pub->nworkers) {
+        throw new std::runtime_error("Checkpoint has fewer workers than the search");
+    }
+    state = read_slot(pub->slots[worker]);
+    return true;
+}
+
+void checkpoint_snapshot(checkpoint_publisher &pub, checkpoint &c)
+{
+    c.search_hash = pub.opt.search_hash;
+    memcpy(c.extra, pub.extra, 32);
+    c.workers.resize(pub.nworkers);
+    for(int i = 0; i < pub.nworkers; i++)
+    {
+        c.workers[i] = read_slot(pub.slots[i]);
+    }
+}
+
+static void writer_loop(checkpoint_publisher &pub)
+{
+    checkpoint c;
+    auto next = std::chrono::steady_clock::now() + std::chrono::duration<double>(pub.opt.interval);
+    while (!pub.stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (std::chrono::steady_clock::now() < next) {
+            continue;
+        }
+        next = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(pub.opt.interval));
+        checkpoint_snapshot(pub, c);
+        try {
+            checkpoint_save(c, pub.opt.path);
+        } catch (std::exception * e) {
+            // a failed write keeps the previous checkpoint, the next interval retries
+            delete e;
+        }
+    }
+}
+
+void checkpoint_publisher_start(checkpoint_publisher &pub, const checkpoint_options &opt, int nworkers,
+    const unsigned char extra[32], const checkpoint * resume)
+{
+    pub.opt = opt;
+    pub.nworkers = nworkers;
+    pub.resumed = resume != nullptr;
+    memcpy(pub.extra, extra, 32);
+    pub.slots.reset(new checkpoint_slot[nworkers]);
+    for(int i = 0; i < nworkers; i++)
+    {
+        pub.slots[i].seq = 0;
+        checkpoint_worker w = resume ? resume->workers[i] : checkpoint_worker();
+        checkpoint_publish(pub, i, w);
+    }
+    pub.stop = false;
+    if (!opt.path.empty()) {
+        pub.thread = std::thread(writer_loop, std::ref(pub));
+    }
+}
+
+void checkpoint_publisher_stop(checkpoint_publisher &pub)
+{
+    if (!pub.thread.joinable()) {
+        return;
+    }
+    pub.stop = true;
+    pub.thread.join();
+
+    checkpoint c;
+    checkpoint_snapshot(pub, c);
+    checkpoint_save(c, pub.opt.path);
+}
+
+checkpoint_publisher::~checkpoint_publisher()
+{
+    stop = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "secp256k1.h"
+#include "ethaddress.h"
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// Resumable search state. Every worker walks from a base (a scalar, or a
+// counter for create2) and has taken steps from it; draws counts the seeds
+// it has taken from its random stream so deterministic runs can fast-forward.
+struct checkpoint_worker
+{
+    secp256k1_scalar base;
+    uint64_t steps;
+    uint64_t draws;
+    uint64_t attempts;
+};
+
+struct checkpoint
+{
+    // identifies the mode, pattern and job, a checkpoint only resumes the same search
+    uint64_t search_hash;
+    // mode specific data that has to survive a restart, e.g. the create2 salt template
+    unsigned char extra[32];
+    std::vector<checkpoint_worker> workers;
+};
+
+bool checkpoint_load(checkpoint &c, const std::string &path);
+void checkpoint_save(const checkpoint &c, const std::string &path);
+
+// FNV-1a, chained over the parts that define a search
+uint64_t checkpoint_hash(uint64_t h, const void * data, size_t len);
+uint64_t checkpoint_hash_pattern(uint64_t h, const eth_pattern &p);
+const uint64_t CHECKPOINT_HASH_INIT = 0xcbf29ce484222325ULL;
+
+struct checkpoint_options
+{
+    std::string path;
+    double interval;
+    uint64_t search_hash;
+};
+
+// One seqlock protected slot per worker. The worker is the only writer and
+// publishes after each chunk of work, the writer thread copies a consistent
+// snapshot and serialises it off the hot path.
+struct alignas(64) checkpoint_slot
+{
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> base[8];
+    std::atomic<uint64_t> steps;
+    std::atomic<uint64_t> draws;
+    std::atomic<uint64_t> attempts;
+};
+
+struct checkpoint_publisher
+{
+    checkpoint_options opt;
+    unsigned char extra[32];
+    int nworkers;
+    bool resumed;
+    std::unique_ptr<checkpoint_slot[]> slots;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    ~checkpoint_publisher();
+};
+
+// resume, if not null, must have nworkers entries and pre-fills the slots so that a stop before the first
+// publish does not lose the resumed state
+void checkpoint_publisher_start(checkpoint_publisher &pub, const checkpoint_options &opt, int nworkers,
+    const unsigned char extra[32], const checkpoint * resume);
+// writes a final checkpoint
+void checkpoint_publisher_stop(checkpoint_publisher &pub);
+
+// true with the worker's saved state when pub is set and was started from a checkpoint
+bool checkpoint_resume(const checkpoint_publisher * pub, int worker, checkpoint_worker &state);
+void checkpoint_publish(checkpoint_publisher &pub, int worker, const checkpoint_worker &state);
+void checkpoint_snapshot(checkpoint_publisher &pub, checkpoint &c);
+
+#endif
@@ -0,0 +1,636 @@
+#include "cluster.h"
+#include "keysearch.h"
+#include "search.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char CLUSTER_MAGIC[4] = {'E', 'C', 'V', 'W'};
+static const size_t CLUSTER_HEADER_SIZE = 8;
+// unsent bytes the coordinator holds for one worker before dropping it as stuck
+static const size_t CLUSTER_MAX_PENDING = 64 * 1024;
+
+static void put_u32(std::vector<unsigned char> &out, uint32_t v)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        out.push_back(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const unsigned char * in)
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void put_u64(std::vector<unsigned char> &out, uint64_t v)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        out.push_back(v >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const unsigned char * in)
+{
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | in[i];
+    }
+    return v;
+}
+
+static void put_scalar(std::vector<unsigned char> &out, const secp256k1_scalar &a)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        for(int b = 3; b >= 0; b--)
+        {
+            out.push_back(a.d[i] >> (8 * b));
+        }
+    }
+}
+
+static secp256k1_scalar get_scalar(const unsigned char * in)
+{
+    secp256k1_scalar a;
+    for(int i = 0; i < 8; i++)
+    {
+        a.d[i] = ((uint32_t)in[4*i] << 24) | ((uint32_t)in[4*i + 1] << 16) | ((uint32_t)in[4*i + 2] << 8) | in[4*i + 3];
+    }
+    return a;
+}
+
+cluster_options cluster_default_options()
+{
+    cluster_options opt = cluster_options();
+    opt.listen = "unix:/tmp/ec-vanity.sock";
+    opt.shard_steps = (uint64_t)1 << 32;
+    opt.timeout = 30;
+    opt.origin = secp256k1_scalar();
+    return opt;
+}
+
+// splits "unix:<path>" or "<host>:<port>", an empty host listens on all interfaces
+static bool parse_address(const std::string &address, std::string &host, std::string &port)
+{
+    const std::string unix_prefix = "unix:";
+    if (address.compare(0, unix_prefix.size(), unix_prefix) == 0) {
+        host = address.substr(unix_prefix.size());
+        port = "";
+        return true;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        throw new std::runtime_error("Address must be unix:<path> or <host>:<port>");
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    return false;
+}
+
+static sockaddr_un unix_address(const std::string &path)
+{
+    sockaddr_un addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+int cluster_listen(const std::string &address)
+{
+    std::string host, port;
+    if (parse_address(address, host, port)) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr = unix_address(host);
+        unlink(host.c_str());
+        if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+            if (fd >= 0) close(fd);
+            throw new std::runtime_error("Could not listen on " + address);
+        }
+        return fd;
+    }
+
+    addrinfo hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo * res;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0) {
+        throw new std::runtime_error("Could not resolve " + address);
+    }
+    int fd = -1;
+    for(addrinfo * ai = res; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if ((bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 64) < 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        throw new std::runtime_error("Could not listen on " + address);
+    }
+    return fd;
+}
+
+int cluster_connect(const std::string &address)
+{
+    std::string host, port;
+    if (parse_address(address, host, port)) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr = unix_address(host);
+        if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            if (fd >= 0) close(fd);
+            throw new std::runtime_error("Could not connect to " + address);
+        }
+        return fd;
+    }
+
+    addrinfo hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo * res;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
+        throw new std::runtime_error("Could not resolve " + address);
+    }
+    int fd = -1;
+    for(addrinfo * ai = res; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        throw new std::runtime_error("Could not connect to " + address);
+    }
+    // progress frames are tiny and latency matters more than packing them
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void append_frame(std::vector<unsigned char> &out, uint8_t type, const std::vector<unsigned char> &payload)
+{
+    size_t start = out.size();
+    put_u32(out, payload.size());
+    out.push_back(type);
+    out.resize(start + CLUSTER_HEADER_SIZE);
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+bool cluster_send(int fd, uint8_t type, const std::vector<unsigned char> &payload)
+{
+    std::vector<unsigned char> frame;
+    append_frame(frame, type, payload);
+
+    size_t off = 0;
+    while (off < frame.size()) {
+        ssize_t n = send(fd, frame.data() + off, frame.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+static bool recv_exact(int fd, unsigned char * out, size_t len)
+{
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = recv(fd, out + off, len - off, 0);
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+// pulls one frame off the front of buf, false if it does not hold a whole one yet
+static bool parse_frame(std::vector<unsigned char> &buf, cluster_message &msg)
+{
+    if (buf.size() < CLUSTER_HEADER_SIZE) {
+        return false;
+    }
+    uint32_t len = get_u32(buf.data());
+    if (buf.size() < CLUSTER_HEADER_SIZE + len) {
+        return false;
+    }
+    msg.type = buf[4];
+    msg.payload.assign(buf.begin() + CLUSTER_HEADER_SIZE, buf.begin() + CLUSTER_HEADER_SIZE + len);
+    buf.erase(buf.begin(), buf.begin() + CLUSTER_HEADER_SIZE + len);
+    return true;
+}
+
+bool cluster_recv(int fd, cluster_message &msg)
+{
+    unsigned char header[CLUSTER_HEADER_SIZE];
+    if (!recv_exact(fd, header, sizeof(header))) {
+        return false;
+    }
+    uint32_t len = get_u32(header);
+    if (len > CLUSTER_MAX_PAYLOAD) {
+        return false;
+    }
+    msg.type = header[4];
+    msg.payload.resize(len);
+    return recv_exact(fd, msg.payload.data(), len);
+}
+
+struct cluster_shard
+{
+    uint64_t id;
+    secp256k1_scalar base;
+    uint64_t steps;
+    uint64_t done;
+};
+
+// client sockets are non-blocking: replies are queued in out and written as
+// the socket takes them, so a worker that stops reading only stalls itself
+struct cluster_client
+{
+    int fd;
+    std::vector<unsigned char> in;
+    std::vector<unsigned char> out;
+    // REQUEST and HIT are only accepted after a valid HELLO
+    bool hello;
+    bool busy;
+    cluster_shard shard;
+    std::chrono::steady_clock::time_point seen;
+};
+
+struct cluster_coordinator
+{
+    const cluster_job &job;
+    const cluster_options &opt;
+    eth_pattern pattern;
+    secp256k1_point customer;
+    std::deque<cluster_shard> queue;
+    secp256k1_scalar next_base;
+    uint64_t next_id;
+    cluster_result res;
+};
+
+// shards given back by dead workers go out before fresh ones
+static cluster_shard next_shard(cluster_coordinator &c)
+{
+    if (!c.queue.empty()) {
+        cluster_shard s = c.queue.front();
+        c.queue.pop_front();
+        return s;
+    }
+    cluster_shard s = {c.next_id++, c.next_base, c.opt.shard_steps, 0};
+    c.next_base = scalar_add<const_time>(c.next_base, scalar_from_uint64(c.opt.shard_steps));
+    return s;
+}
+
+static void release_shard(cluster_coordinator &c, cluster_client &cl)
+{
+    if (cl.busy && cl.shard.done < cl.shard.steps) {
+        cluster_shard rest = cl.shard;
+        rest.base = scalar_add<const_time>(rest.base, scalar_from_uint64(rest.done));
+        rest.steps -= rest.done;
+        rest.done = 0;
+        c.queue.push_front(rest);
+        c.res.reassigned++;
+    }
+    cl.busy = false;
+}
+
+// the walk checks base + 1 onwards, so the reported scalar is the key itself
+static bool verify_hit(cluster_coordinator &c, const secp256k1_scalar &key)
+{
+    secp256k1_point pt = double_and_add<const_time>(key, SECP256K1_GENERATOR);
+    if (c.job.mode == CLUSTER_MODE_SPLITKEY) {
+        pt = point_add<const_time>(c.customer, pt);
+    }
+    if (point_is_infinity(pt)) {
+        return false;
+    }
+    secp256k1_key_uncompressed k;
+    serialize_uncompressed(&k, &pt, 1);
+    eth_address addr;
+    eth_address_from_pubkey(addr, k.bytes + 1);
+    if (!eth_match(c.pattern, addr)) {
+        return false;
+    }
+    c.res.found = true;
+    c.res.key = key;
+    c.res.point = pt;
+    c.res.address = addr;
+    return true;
+}
+
+// false when the socket is broken
+static bool flush_client(cluster_client &cl)
+{
+    size_t off = 0;
+    while (off < cl.out.size()) {
+        ssize_t n = send(cl.fd, cl.out.data() + off, cl.out.size() - off, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    cl.out.erase(cl.out.begin(), cl.out.begin() + off);
+    return true;
+}
+
+// false drops the client, also when it has let too much go unread
+static bool queue_send(cluster_client &cl, uint8_t type, const std::vector<unsigned char> &payload)
+{
+    append_frame(cl.out, type, payload);
+    return flush_client(cl) && cl.out.size() <= CLUSTER_MAX_PENDING;
+}
+
+// false drops the client
+static bool handle_message(cluster_coordinator &c, cluster_client &cl, const cluster_message &msg)
+{
+    const std::vector<unsigned char> &p = msg.payload;
+    if (!cl.hello && msg.type != CLUSTER_HELLO) {
+        return false;
+    }
+    switch (msg.type) {
+    case CLUSTER_HELLO: {
+        if (cl.hello || p.size() != 8 || memcmp(p.data(), CLUSTER_MAGIC, 4) != 0
+            || get_u32(p.data() + 4) != CLUSTER_VERSION) {
+            return false;
+        }
+        cl.hello = true;
+        std::vector<unsigned char> out;
+        out.push_back(c.job.mode);
+        out.push_back(c.job.checksum_case);
+        out.insert(out.end(), c.job.customer.bytes, c.job.customer.bytes + sizeof(c.job.customer.bytes));
+        out.insert(out.end(), c.job.pattern.begin(), c.job.pattern.end());
+        return queue_send(cl, CLUSTER_JOB, out);
+    }
+    case CLUSTER_REQUEST: {
+        release_shard(c, cl);
+        cl.shard = next_shard(c);
+        cl.busy = true;
+        std::vector<unsigned char> out;
+        put_u64(out, cl.shard.id);
+        put_scalar(out, cl.shard.base);
+        put_u64(out, cl.shard.steps);
+        return queue_send(cl, CLUSTER_ASSIGN, out);
+    }
+    case CLUSTER_PROGRESS: {
+        if (p.size() != 16 || !cl.busy || get_u64(p.data()) != cl.shard.id) {
+            return false;
+        }
+        uint64_t done = get_u64(p.data() + 8);
+        if (done < cl.shard.done || done > cl.shard.steps) {
+            return false;
+        }
+        c.res.attempts += done - cl.shard.done;
+        cl.shard.done = done;
+        return true;
+    }
+    case CLUSTER_HIT: {
+        if (p.size() != 48 || !cl.busy || get_u64(p.data()) != cl.shard.id) {
+            return false;
+        }
+        uint64_t done = get_u64(p.data() + 40);
+        if (done < cl.shard.done || done > cl.shard.steps) {
+            return false;
+        }
+        c.res.attempts += done - cl.shard.done;
+        cl.shard.done = done;
+        if (!verify_hit(c, get_scalar(p.data() + 8))) {
+            std::cerr << "cluster: rejected a hit that does not verify" << std::endl;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+cluster_result cluster_coordinate(const cluster_job &job, const cluster_options &opt)
+{
+    cluster_coordinator c = {job, opt, eth_pattern_compile(job.pattern, job.checksum_case), SECP256K1_INFINITY,
+        {}, opt.origin, 0, cluster_result()};
+    if (job.mode == CLUSTER_MODE_SPLITKEY && !point_decompress(c.customer, job.customer)) {
+        throw new std::runtime_error("Customer key is not a valid compressed point");
+    }
+    if (opt.shard_steps == 0 || !(opt.timeout > 0)) {
+        throw new std::runtime_error("Shards need at least one key and the timeout must be positive");
+    }
+
+    int listen_fd = cluster_listen(opt.listen);
+    std::vector<cluster_client> clients;
+    auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(opt.timeout));
+
+    while (!c.res.found) {
+        std::vector<pollfd> fds(1 + clients.size());
+        fds[0] = {listen_fd, POLLIN, 0};
+        for(size_t i = 0; i < clients.size(); i++)
+        {
+            fds[i + 1] = {clients[i].fd, (short)(POLLIN | (clients[i].out.empty() ? 0 : POLLOUT)), 0};
+        }
+        poll(fds.data(), fds.size(), 100);
+        auto now = std::chrono::steady_clock::now();
+
+        std::vector<bool> drop(clients.size(), false);
+        for(size_t i = 0; i < clients.size(); i++)
+        {
+            cluster_client &cl = clients[i];
+            if ((fds[i + 1].revents & POLLOUT) && !flush_client(cl)) {
+                drop[i] = true;
+                continue;
+            }
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                unsigned char buf[4096];
+                ssize_t n = recv(cl.fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    continue;
+                }
+                if (n <= 0) {
+                    drop[i] = true;
+                    continue;
+                }
+                cl.in.insert(cl.in.end(), buf, buf + n);
+                cl.seen = now;
+
+                cluster_message msg;
+                while (!drop[i] && !c.res.found && parse_frame(cl.in, msg)) {
+                    drop[i] = !handle_message(c, cl, msg);
+                }
+                if (cl.in.size() > CLUSTER_HEADER_SIZE + CLUSTER_MAX_PAYLOAD) {
+                    drop[i] = true;
+                }
+            }
+            if (now - cl.seen > timeout) {
+                drop[i] = true;
+            }
+        }
+
+        // a worker that is only slow is cut off too, it stops at its next report instead of walking on
+        // through a shard that was handed on
+        for(size_t i = clients.size(); i-- > 0;)
+        {
+            if (!drop[i]) {
+                continue;
+            }
+            if (clients[i].busy) {
+                std::cerr << "cluster: lost a worker, shard " << clients[i].shard.id << " requeued" << std::endl;
+            }
+            release_shard(c, clients[i]);
+            close(clients[i].fd);
+            clients.erase(clients.begin() + i);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd >= 0) {
+                cluster_client cl = cluster_client();
+                cl.fd = fd;
+                cl.seen = now;
+                clients.push_back(cl);
+            }
+        }
+    }
+
+    // best effort, a worker that does not take the stop notices the closed connection
+    for(cluster_client &cl : clients)
+    {
+        queue_send(cl, CLUSTER_STOP, {});
+        close(cl.fd);
+    }
+    close(listen_fd);
+    std::string host, port;
+    if (parse_address(opt.listen, host, port)) {
+        unlink(host.c_str());
+    }
+    return c.res;
+}
+
+// STOP is the only message the coordinator sends unasked
+static bool stop_pending(int fd)
+{
+    pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) != 0;
+}
+
+static void work_connection(int fd, const std::vector<secp256k1_point> &table, search_control &ctl)
+{
+    std::vector<unsigned char> hello(CLUSTER_MAGIC, CLUSTER_MAGIC + 4);
+    put_u32(hello, CLUSTER_VERSION);
+    cluster_message msg;
+    if (!cluster_send(fd, CLUSTER_HELLO, hello) || !cluster_recv(fd, msg) || msg.type != CLUSTER_JOB || msg.payload.size() < 35) {
+        return;
+    }
+
+    bool splitkey = msg.payload[0] == CLUSTER_MODE_SPLITKEY;
+    eth_pattern p = eth_pattern_compile(std::string(msg.payload.begin() + 35, msg.payload.end()), msg.payload[1]);
+    secp256k1_point q = SECP256K1_INFINITY;
+    secp256k1_key_compressed customer;
+    memcpy(customer.bytes, msg.payload.data() + 2, sizeof(customer.bytes));
+    if (splitkey && !point_decompress(q, customer)) {
+        return;
+    }
+
+    size_t batch = table.size();
+    keysearch_walker w;
+    keysearch_walker_init(w, table.data(), batch);
+    keysearch_hit hit;
+
+    while (!ctl.stop) {
+        if (!cluster_send(fd, CLUSTER_REQUEST, {}) || !cluster_recv(fd, msg)) {
+            return;
+        }
+        if (msg.type != CLUSTER_ASSIGN || msg.payload.size() != 48) {
+            return;
+        }
+        uint64_t id = get_u64(msg.payload.data());
+        secp256k1_scalar base = get_scalar(msg.payload.data() + 8);
+        uint64_t steps = get_u64(msg.payload.data() + 40);
+
+        secp256k1_point at = double_and_add<const_time>(base, SECP256K1_GENERATOR);
+        if (splitkey) {
+            at = point_add<const_time>(q, at);
+        }
+
+        // whole batches, then the last partial batch over the same buffers and
+        // a prefix of the table, so a walk never runs into the next shard
+        uint64_t done = 0;
+        while (done < steps && !ctl.stop) {
+            uint64_t left = steps - done;
+            uint64_t chunk = std::min(KEYSEARCH_CHUNK_STEPS, left - left % batch);
+            if (left < batch) {
+                w.batch = left;
+                chunk = left;
+            }
+
+            uint64_t n = keysearch_walk(w, at, p, ctl, chunk, hit);
+            w.batch = batch;
+            at = w.last;
+            if (hit.found) {
+                std::vector<unsigned char> out;
+                put_u64(out, id);
+                put_scalar(out, scalar_add<const_time>(base, scalar_from_uint64(done + hit.step + 1)));
+                put_u64(out, done + n);
+                if (!cluster_send(fd, CLUSTER_HIT, out)) {
+                    return;
+                }
+            }
+            done += n;
+
+            std::vector<unsigned char> out;
+            put_u64(out, id);
+            put_u64(out, done);
+            if (!cluster_send(fd, CLUSTER_PROGRESS, out) || stop_pending(fd)) {
+                return;
+            }
+        }
+    }
+}
+
+void cluster_work(const std::string &address, int nthreads, size_t batch)
+{
+    std::vector<secp256k1_point> table(batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, batch);
+
+    // one connection per thread, a thread that loses its connection or is told
+    // to stop ends the others too
+    search_control ctl;
+    search_run(nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        int fd = -1;
+        try {
+            fd = cluster_connect(address);
+        } catch (std::exception * e) {
+            delete e;
+            ctl.stop = true;
+            return;
+        }
+        work_connection(fd, table, ctl);
+        close(fd);
+        ctl.stop = true;
+    });
+}
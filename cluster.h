@@ -0,0 +1,98 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "secp256k1.h"
+#include "ethaddress.h"
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+// Sharding one key search over many processes and hosts.
+//
+// The coordinator cuts the key space after a random origin into shards of
+// shard_steps consecutive scalars and hands them out one at a time. Every
+// worker thread holds its own connection, walks exactly one shard with the
+// batched walk and reports its progress after each chunk, which doubles as the
+// heartbeat. When a connection closes or stays silent longer than the timeout
+// the unreported rest of its shard goes back to the queue. A worker that was
+// only slow notices the closed connection at its next report, so it walks at
+// most one chunk (KEYSEARCH_CHUNK_STEPS) that another worker walks again.
+//
+// The coordinator never blocks on one worker: its sockets are non-blocking and
+// replies wait in a per-connection buffer, a worker that lets too much pile up
+// is dropped. Only HELLO is accepted before a HELLO has been answered.
+//
+// Addresses are "unix:<path>" or "<host>:<port>".
+
+enum cluster_mode
+{
+    CLUSTER_MODE_ETH = 0,
+    CLUSTER_MODE_SPLITKEY = 1
+};
+
+// Frames are a 4 byte little-endian payload length, a type byte, three zero bytes and the payload.
+enum cluster_message_type
+{
+    CLUSTER_HELLO = 1,      // w->c  "ECVW", u32 version
+    CLUSTER_JOB = 2,        // c->w  mode, checksum_case, customer key[33], pattern
+    CLUSTER_REQUEST = 3,    // w->c  empty, asks for the next shard
+    CLUSTER_ASSIGN = 4,     // c->w  u64 shard id, base[32], u64 steps
+    CLUSTER_PROGRESS = 5,   // w->c  u64 shard id, u64 steps walked
+    CLUSTER_HIT = 6,        // w->c  u64 shard id, scalar[32], u64 steps walked up to the hit
+    CLUSTER_STOP = 7        // c->w  empty
+};
+
+const uint32_t CLUSTER_VERSION = 1;
+const size_t CLUSTER_MAX_PAYLOAD = 4096;
+
+struct cluster_message
+{
+    uint8_t type;
+    std::vector<unsigned char> payload;
+};
+
+struct cluster_job
+{
+    cluster_mode mode;
+    std::string pattern;
+    bool checksum_case;
+    // splitkey only, the walk is over Q + kG
+    secp256k1_key_compressed customer;
+};
+
+struct cluster_options
+{
+    std::string listen;
+    uint64_t shard_steps;
+    // seconds without a message before a worker counts as dead
+    double timeout;
+    // start of the key space, shard i starts at origin + i * shard_steps
+    secp256k1_scalar origin;
+};
+
+// key is the private key, or the offset to add to the customer's secret
+struct cluster_result
+{
+    bool found;
+    secp256k1_scalar key;
+    secp256k1_point point;
+    eth_address address;
+    uint64_t attempts;
+    uint64_t reassigned;
+};
+
+cluster_options cluster_default_options();
+
+// Runs until a worker reports a hit that verifies and then stops all workers.
+cluster_result cluster_coordinate(const cluster_job &job, const cluster_options &opt);
+// Runs nthreads connections to the coordinator until it sends stop or goes away.
+void cluster_work(const std::string &address, int nthreads, size_t batch);
+
+int cluster_listen(const std::string &address);
+int cluster_connect(const std::string &address);
+// blocking, false when the connection is closed or broken
+bool cluster_send(int fd, uint8_t type, const std::vector<unsigned char> &payload);
+bool cluster_recv(int fd, cluster_message &msg);
+
+#endif
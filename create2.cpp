@@ -0,0 +1,136 @@
+#include "create2.h"
+#include "search.h"
+#include "resultsink.h"
+#include <cstring>
+#include <mutex>
+
+static void create2_input(unsigned char in[CREATE2_INPUT_SIZE], const create2_job &job)
+{
+    in[0] = 0xff;
+    memcpy(in + 1, job.deployer, 20);
+    memcpy(in + 21, job.salt, 32);
+    memcpy(in + 53, job.init_code_hash, 32);
+}
+
+create2_state create2_prepare(const create2_job &job)
+{
+    unsigned char block[KECCAK256_RATE] = {0};
+    create2_input(block, job);
+    memset(block + CREATE2_COUNTER_OFFSET, 0, 8);
+    block[CREATE2_INPUT_SIZE] ^= 0x01;
+    block[KECCAK256_RATE - 1] ^= 0x80;
+
+    create2_state s = create2_state();
+    memcpy(s.st, block, KECCAK256_RATE);
+    return s;
+}
+
+void create2_salt(unsigned char salt[32], const create2_job &job, uint64_t counter)
+{
+    memcpy(salt, job.salt, 32);
+    for(int i = 0; i < 8; i++)
+    {
+        salt[24 + i] = counter >> (56 - 8*i);
+    }
+}
+
+// reference path through the generic hash
+void create2_address(eth_address &addr, const create2_job &job, uint64_t counter)
+{
+    unsigned char in[CREATE2_INPUT_SIZE];
+    create2_input(in, job);
+    create2_salt(in + 21, job, counter);
+
+    unsigned char hash[32];
+    keccak256(hash, in, CREATE2_INPUT_SIZE);
+    memcpy(addr.bytes, hash + 12, ETH_ADDRESS_SIZE);
+}
+
+// Addresses for counter .. counter + KECCAK_LANES - 1.
+// The counter occupies input bytes 45..52, i.e. the top three bytes of lane 5
+// and the low five bytes of lane 6, so only those two lanes differ per candidate.
+void create2_address_x4(eth_address addr[KECCAK_LANES], const create2_state &s, uint64_t counter)
+{
+    uint64_t st[25][KECCAK_LANES];
+    for(int i = 0; i < 25; i++)
+    {
+        for(int l = 0; l < KECCAK_LANES; l++) {
+            st[i][l] = s.st[i];
+        }
+    }
+    for(int l = 0; l < KECCAK_LANES; l++)
+    {
+        uint64_t be = __builtin_bswap64(counter + l);
+        st[5][l] ^= be << 40;
+        st[6][l] ^= be >> 24;
+    }
+
+    keccakf1600_x4(st);
+
+    for(int l = 0; l < KECCAK_LANES; l++)
+    {
+        uint64_t out[4] = {st[0][l], st[1][l], st[2][l], st[3][l]};
+        memcpy(addr[l].bytes, (unsigned char *)out + 12, ETH_ADDRESS_SIZE);
+    }
+}
+
+create2_result create2_search(const create2_job &job, const eth_pattern &p, int nthreads, uint64_t start,
+    checkpoint_publisher * checkpoint, result_sink * sink)
+{
+    const create2_state s = create2_prepare(job);
+    const uint64_t batch = 1024;
+
+    create2_result res = create2_result();
+    std::mutex res_lock;
+    search_control ctl;
+
+    search_run(nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        checkpoint_worker state = checkpoint_worker();
+        checkpoint_resume(checkpoint, worker, state);
+
+        eth_address addr[KECCAK_LANES];
+        for(uint64_t b = worker + state.steps * nworkers; !ctl.stop; b += nworkers)
+        {
+            uint64_t base = start + b * batch * KECCAK_LANES;
+            STATS_TIMER_START(t_hash);
+            for(uint64_t i = 0; i < batch; i++)
+            {
+                uint64_t counter = base + i * KECCAK_LANES;
+                create2_address_x4(addr, s, counter);
+                for(int l = 0; l < KECCAK_LANES; l++)
+                {
+                    if (!eth_match(p, addr[l])) {
+                        continue;
+                    }
+                    if (sink) {
+                        result_record rec = {secp256k1_scalar(), counter + l, addr[l]};
+                        if (result_sink_push(*sink, worker, rec)) {
+                            ctl.stop = true;
+                        }
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> guard(res_lock);
+                    if (!res.found) {
+                        res.found = true;
+                        res.counter = counter + l;
+                        res.address = addr[l];
+                        create2_salt(res.salt, job, res.counter);
+                    }
+                    ctl.stop = true;
+                }
+            }
+            STATS_TIMER_STOP(t_hash, STATS_STAGE_HASH);
+            search_count(ctl, batch * KECCAK_LANES);
+
+            state.steps++;
+            state.attempts += batch * KECCAK_LANES;
+            if (checkpoint) {
+                checkpoint_publish(*checkpoint, worker, state);
+            }
+            if (sink && result_sink_full(*sink)) {
+                ctl.stop = true;
+            }
+        }
+    });
+    return res;
+}
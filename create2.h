@@ -0,0 +1,52 @@
+#include <cstdint>
+#include "ethaddress.h"
+#include "keccak.h"
+#include "checkpoint.h"
+
+#ifndef CREATE2_H
+#define CREATE2_H
+
+// CREATE2 address: keccak256(0xff ++ deployer ++ salt ++ init_code_hash)[12:]
+// The 85 byte input fits in a single Keccak block. The search variable is a
+// 64-bit counter stored big-endian in the last 8 bytes of the salt, the rest of
+// the salt is a fixed template chosen by the caller.
+const int CREATE2_INPUT_SIZE = 85;
+const int CREATE2_COUNTER_OFFSET = 1 + 20 + 24;
+
+struct create2_job
+{
+    unsigned char deployer[20];
+    unsigned char salt[32];
+    unsigned char init_code_hash[32];
+};
+
+// padded input block with the counter bytes left at zero
+struct create2_state
+{
+    uint64_t st[25];
+};
+
+// resultsink.h needs create2_job to verify hits
+struct result_sink;
+
+struct create2_result
+{
+    bool found;
+    uint64_t counter;
+    unsigned char salt[32];
+    eth_address address;
+};
+
+create2_state create2_prepare(const create2_job &job);
+void create2_salt(unsigned char salt[32], const create2_job &job, uint64_t counter);
+void create2_address(eth_address &addr, const create2_job &job, uint64_t counter);
+void create2_address_x4(eth_address addr[KECCAK_LANES], const create2_state &s, uint64_t counter);
+
+// Worker w hashes the blocks w, w + nthreads, ... of 4096 counters from start.
+// With a checkpoint publisher its steps are the blocks it has finished, the
+// salt template is not part of the worker state and has to be restored by the caller.
+// With a sink every hit goes there and the search runs on until the sink's limit.
+create2_result create2_search(const create2_job &job, const eth_pattern &p, int nthreads, uint64_t start,
+    checkpoint_publisher * checkpoint, result_sink * sink);
+
+#endif
@@ -0,0 +1,151 @@
+#include "difficulty.h"
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+// Walks the patterns nibble by nibble like a trie. Every nibble of a random
+// address is uniform and independent, and so is the EIP-55 checksum bit of
+// each letter, so the probability of a branch is the product along its path.
+static double union_probability(const std::vector<const eth_pattern *> &set, int n)
+{
+    if (set.empty()) {
+        return 0.0;
+    }
+    for(const eth_pattern * p : set)
+    {
+        // a pattern that ends here is satisfied by the whole subtree
+        if (p->nnibbles <= n) {
+            return 1.0;
+        }
+    }
+
+    // the checksum bit only splits the branch when some pattern here checks it,
+    // otherwise a case-insensitive prefix would cost 2^letters
+    bool case_matters = false;
+    for(const eth_pattern * p : set)
+    {
+        case_matters |= (p->case_care >> n) & 1;
+    }
+
+    // branches that keep the same patterns are walked once with their weights
+    // summed, mostly the 15 values no pattern continues with
+    std::vector<std::pair<std::vector<const eth_pattern *>, double>> branches;
+    for(int v = 0; v < 16; v++)
+    {
+        // case 0 is lowercase, 1 is uppercase, only letters have a case
+        int ncases = v >= 10 && case_matters ? 2 : 1;
+        for(int c = 0; c < ncases; c++)
+        {
+            std::vector<const eth_pattern *> next;
+            for(const eth_pattern * p : set)
+            {
+                int nibble = (n % 2 == 0) ? p->value[n/2] >> 4 : p->value[n/2] & 0xF;
+                if (nibble != v) {
+                    continue;
+                }
+                bool care = (p->case_care >> n) & 1;
+                bool upper = (p->case_upper >> n) & 1;
+                if (care && upper != (c == 1)) {
+                    continue;
+                }
+                next.push_back(p);
+            }
+
+            double weight = 1.0 / 16.0 / ncases;
+            bool merged = false;
+            for(auto &b : branches)
+            {
+                if (b.first == next) {
+                    b.second += weight;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                branches.emplace_back(next, weight);
+            }
+        }
+    }
+
+    double total = 0.0;
+    for(const auto &b : branches)
+    {
+        total += union_probability(b.first, n + 1) * b.second;
+    }
+    return total;
+}
+
+double difficulty_probability(const std::vector<eth_pattern> &patterns)
+{
+    std::vector<const eth_pattern *> set;
+    for(const eth_pattern &p : patterns)
+    {
+        set.push_back(&p);
+    }
+    return union_probability(set, 0);
+}
+
+// smallest n with 1 - (1 - p)^n >= q
+double difficulty_attempts_quantile(double probability, double q)
+{
+    if (probability >= 1.0) {
+        return 1.0;
+    }
+    return std::ceil(std::log1p(-q) / std::log1p(-probability));
+}
+
+difficulty_estimate difficulty_estimate_patterns(const std::vector<eth_pattern> &patterns)
+{
+    return difficulty_estimate_probability(difficulty_probability(patterns));
+}
+
+difficulty_estimate difficulty_estimate_probability(double probability)
+{
+    difficulty_estimate e;
+    e.probability = probability;
+    e.expected_attempts = 1.0 / e.probability;
+    e.p50_attempts = difficulty_attempts_quantile(e.probability, 0.50);
+    e.p90_attempts = difficulty_attempts_quantile(e.probability, 0.90);
+    e.p99_attempts = difficulty_attempts_quantile(e.probability, 0.99);
+    return e;
+}
+
+static std::string format_duration(double seconds)
+{
+    char buf[64];
+    if (seconds < 120) {
+        snprintf(buf, sizeof(buf), "%.1f s", seconds);
+    } else if (seconds < 2 * 3600) {
+        snprintf(buf, sizeof(buf), "%.1f min", seconds / 60);
+    } else if (seconds < 2 * 86400) {
+        snprintf(buf, sizeof(buf), "%.1f h", seconds / 3600);
+    } else {
+        snprintf(buf, sizeof(buf), "%.1f days", seconds / 86400);
+    }
+    return buf;
+}
+
+std::string difficulty_report(const difficulty_estimate &e, double keys_per_sec)
+{
+    std::string out;
+    char line[160];
+    snprintf(line, sizeof(line), "match probability: %.3g (1 in %.4g)\n", e.probability, e.expected_attempts);
+    out += line;
+
+    const char * names[] = {"expected", "P50", "P90", "P99"};
+    double attempts[] = {e.expected_attempts, e.p50_attempts, e.p90_attempts, e.p99_attempts};
+    for(int i = 0; i < 4; i++)
+    {
+        snprintf(line, sizeof(line), "%-8s %.4g attempts", names[i], attempts[i]);
+        out += line;
+        if (keys_per_sec > 0) {
+            out += ", " + format_duration(attempts[i] / keys_per_sec);
+        }
+        out += "\n";
+    }
+    if (keys_per_sec > 0) {
+        snprintf(line, sizeof(line), "at %.4g keys/s\n", keys_per_sec);
+        out += line;
+    }
+    return out;
+}
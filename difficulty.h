@@ -0,0 +1,29 @@
+#include <string>
+#include <vector>
+#include "ethaddress.h"
+
+#ifndef DIFFICULTY_H
+#define DIFFICULTY_H
+
+// Expected work for a set of patterns, an address is a hit if it matches any of them.
+// Attempts to the first hit are geometric, quantiles are in attempts.
+struct difficulty_estimate
+{
+    double probability;
+    double expected_attempts;
+    double p50_attempts;
+    double p90_attempts;
+    double p99_attempts;
+};
+
+// exact probability of the union, overlapping patterns are only counted once
+double difficulty_probability(const std::vector<eth_pattern> &patterns);
+double difficulty_attempts_quantile(double probability, double q);
+difficulty_estimate difficulty_estimate_patterns(const std::vector<eth_pattern> &patterns);
+// for other address kinds, from the probability of one attempt being a hit
+difficulty_estimate difficulty_estimate_probability(double probability);
+
+// human readable summary, keys_per_sec <= 0 leaves out wall-clock times
+std::string difficulty_report(const difficulty_estimate &e, double keys_per_sec);
+
+#endif
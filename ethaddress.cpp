@@ -0,0 +1,137 @@
+#include "ethaddress.h"
+#include "keccak.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+static const char HEX_LOWER[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+eth_pattern eth_pattern_compile(const std::string &pattern, bool checksum_case)
+{
+    eth_pattern p = eth_pattern();
+    size_t start = 0;
+    if (pattern.size() >= 2 && pattern[0] == '0' && (pattern[1] == 'x' || pattern[1] == 'X')) {
+        start = 2;
+    }
+
+    if (pattern.size() - start > ETH_ADDRESS_NIBBLES) {
+        throw new std::runtime_error("Pattern is longer than an address");
+    }
+
+    for(size_t i = start; i < pattern.size(); i++)
+    {
+        int v = hex_value(pattern[i]);
+        if (v < 0) {
+            throw new std::runtime_error("Pattern contains a non-hex character");
+        }
+
+        int n = p.nnibbles++;
+        int shift = (n % 2 == 0) ? 4 : 0;
+        p.value[n/2] |= v << shift;
+        p.mask[n/2] |= 0xF << shift;
+
+        if (checksum_case && v >= 10) {
+            p.case_care |= (uint64_t)1 << n;
+            if (pattern[i] >= 'A' && pattern[i] <= 'F') {
+                p.case_upper |= (uint64_t)1 << n;
+            }
+        }
+    }
+    p.nbytes = (p.nnibbles + 1) / 2;
+    return p;
+}
+
+// each nibble is 1/16, each case-sensitive letter another 1/2 from the checksum bit
+double eth_pattern_probability(const eth_pattern &p)
+{
+    return std::ldexp(1.0, -4 * p.nnibbles - __builtin_popcountll(p.case_care));
+}
+
+bool eth_match_nibbles(const eth_pattern &p, const eth_address &addr)
+{
+    for(int i = 0; i < p.nbytes; i++)
+    {
+        if ((addr.bytes[i] & p.mask[i]) != p.value[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// EIP-55: hex digit i is uppercase iff nibble i of keccak256(lowercase hex) is >= 8
+bool eth_match_checksum(const eth_pattern &p, const eth_address &addr)
+{
+    unsigned char hash[32];
+    eth_checksum_hash(hash, addr);
+
+    uint64_t care = p.case_care;
+    while (care) {
+        int n = __builtin_ctzll(care);
+        care &= care - 1;
+
+        unsigned char bit = (n % 2 == 0) ? 0x80 : 0x08;
+        bool upper = (hash[n/2] & bit) != 0;
+        bool want_upper = (p.case_upper >> n) & 1;
+        if (upper != want_upper) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// cheap filter first, the second keccak only runs for ~1 in 16^n candidates
+bool eth_match(const eth_pattern &p, const eth_address &addr)
+{
+    if (!eth_match_nibbles(p, addr)) {
+        return false;
+    }
+    if (!p.case_care) {
+        return true;
+    }
+    return eth_match_checksum(p, addr);
+}
+
+void eth_address_from_pubkey(eth_address &addr, const unsigned char xy[64])
+{
+    unsigned char hash[32];
+    keccak256(hash, xy, 64);
+    memcpy(addr.bytes, hash + 12, ETH_ADDRESS_SIZE);
+}
+
+void eth_checksum_hash(unsigned char hash[32], const eth_address &addr)
+{
+    unsigned char hex[ETH_ADDRESS_NIBBLES];
+    for(int i = 0; i < ETH_ADDRESS_SIZE; i++)
+    {
+        hex[2*i] = HEX_LOWER[addr.bytes[i] >> 4];
+        hex[2*i + 1] = HEX_LOWER[addr.bytes[i] & 0xF];
+    }
+    keccak256(hash, hex, ETH_ADDRESS_NIBBLES);
+}
+
+std::string eth_address_to_string(const eth_address &addr)
+{
+    unsigned char hash[32];
+    eth_checksum_hash(hash, addr);
+
+    std::string res = "0x";
+    for(int n = 0; n < ETH_ADDRESS_NIBBLES; n++)
+    {
+        int v = (n % 2 == 0) ? addr.bytes[n/2] >> 4 : addr.bytes[n/2] & 0xF;
+        char c = HEX_LOWER[v];
+        unsigned char bit = (n % 2 == 0) ? 0x80 : 0x08;
+        if (v >= 10 && (hash[n/2] & bit)) {
+            c = c - 'a' + 'A';
+        }
+        res += c;
+    }
+    return res;
+}
@@ -0,0 +1,42 @@
+#include <cstdint>
+#include <string>
+
+#ifndef ETHADDRESS_H
+#define ETHADDRESS_H
+
+const int ETH_ADDRESS_SIZE = 20;
+const int ETH_ADDRESS_NIBBLES = 2 * ETH_ADDRESS_SIZE;
+
+struct eth_address
+{
+    unsigned char bytes[ETH_ADDRESS_SIZE];
+};
+
+// Prefix pattern on the hex form of an address.
+// The nibble part (value/mask) is case-insensitive and is checked first on the raw address bytes.
+// Letters whose case matters are recorded as bits in case_care/case_upper (bit i = nibble i)
+// and are only checked against the EIP-55 checksum when the nibbles already match.
+struct eth_pattern
+{
+    unsigned char value[ETH_ADDRESS_SIZE];
+    unsigned char mask[ETH_ADDRESS_SIZE];
+    int nbytes;
+    int nnibbles;
+    uint64_t case_care;
+    uint64_t case_upper;
+};
+
+eth_pattern eth_pattern_compile(const std::string &pattern, bool checksum_case);
+
+// chance that one uniformly random address matches
+double eth_pattern_probability(const eth_pattern &p);
+
+bool eth_match_nibbles(const eth_pattern &p, const eth_address &addr);
+bool eth_match_checksum(const eth_pattern &p, const eth_address &addr);
+bool eth_match(const eth_pattern &p, const eth_address &addr);
+
+void eth_address_from_pubkey(eth_address &addr, const unsigned char xy[64]);
+void eth_checksum_hash(unsigned char hash[32], const eth_address &addr);
+std::string eth_address_to_string(const eth_address &addr);
+
+#endif
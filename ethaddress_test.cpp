@@ -0,0 +1,759 @@
+// use cxxtest
+
+#include <cxxtest/TestSuite.h>
+#include <string>
+#include <cstring>
+#include "keccak.h"
+#include "ethaddress.h"
+#include "create2.h"
+#include "splitkey.h"
+#include "keysearch.h"
+#include "stats.h"
+#include "difficulty.h"
+#include "tune.h"
+#include "checkpoint.h"
+#include "cluster.h"
+#include "resultsink.h"
+#include "sha256.h"
+#include "taproot.h"
+#include <cstdio>
+#include <memory>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+static eth_address address_from_hex(const std::string &s)
+{
+    eth_address addr = eth_address();
+    for(int i = 0; i < ETH_ADDRESS_SIZE; i++)
+    {
+        addr.bytes[i] = std::stoul(s.substr(2 + 2*i, 2), nullptr, 16);
+    }
+    return addr;
+}
+
+static std::string hex(const unsigned char * d, int n)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string res;
+    for(int i = 0; i < n; i++)
+    {
+        res += digits[d[i] >> 4];
+        res += digits[d[i] & 0xF];
+    }
+    return res;
+}
+
+class EthAddressTestSuite : public CxxTest::TestSuite
+{
+public:
+  void testKeccakEmpty()
+  {
+    unsigned char h[32];
+    keccak256(h, nullptr, 0);
+    TS_ASSERT_EQUALS(hex(h, 32), "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+  }
+
+  void testKeccakMultiBlock()
+  {
+    // 200 bytes spans two rate blocks
+    unsigned char in[200];
+    memset(in, 'a', sizeof(in));
+    unsigned char h1[32];
+    unsigned char h2[32];
+    keccak256(h1, in, sizeof(in));
+    in[150] = 'b';
+    keccak256(h2, in, sizeof(in));
+    TS_ASSERT_DIFFERS(hex(h1, 32), hex(h2, 32));
+  }
+
+  void testChecksumEncoding()
+  {
+    const char * vectors[] = {
+      "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed",
+      "0xfB6916095ca1df60bB79Ce92cE3Ea74c37c5d359",
+      "0xdbF03B407c01E7cD3CBea99509d93f8DDDC8C6FB",
+      "0xD1220A0cf47c7B9Be7A2E6BA89F429762e7b9aDb"
+    };
+    for(const char * v : vectors)
+    {
+      TS_ASSERT_EQUALS(eth_address_to_string(address_from_hex(v)), std::string(v));
+    }
+  }
+
+  void testCaseInsensitivePatternMatches()
+  {
+    eth_address addr = address_from_hex("0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed");
+    TS_ASSERT(eth_match(eth_pattern_compile("0x5aaeb", false), addr));
+    TS_ASSERT(eth_match(eth_pattern_compile("5AAEB6", false), addr));
+    TS_ASSERT(!eth_match(eth_pattern_compile("0x5aaec", false), addr));
+  }
+
+  void testChecksumPatternMatches()
+  {
+    eth_address addr = address_from_hex("0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed");
+    TS_ASSERT(eth_match(eth_pattern_compile("0x5aAeb6053F", true), addr));
+    TS_ASSERT(eth_match_nibbles(eth_pattern_compile("0x5AAeb", true), addr));
+    TS_ASSERT(!eth_match(eth_pattern_compile("0x5AAeb", true), addr));
+    TS_ASSERT(!eth_match(eth_pattern_compile("0x5aaeb", true), addr));
+  }
+
+  void testOddLengthPattern()
+  {
+    eth_address addr = address_from_hex("0xfB6916095ca1df60bB79Ce92cE3Ea74c37c5d359");
+    TS_ASSERT(eth_match(eth_pattern_compile("0xfB6", true), addr));
+    TS_ASSERT(!eth_match(eth_pattern_compile("0xfB7", true), addr));
+  }
+
+  void testInvalidPatternThrows()
+  {
+    TS_ASSERT_THROWS_ANYTHING(eth_pattern_compile("0xhello", false));
+    TS_ASSERT_THROWS_ANYTHING(eth_pattern_compile(std::string(41, 'a'), false));
+  }
+
+  // EIP-1014 examples with init_code 0x00
+  static create2_job eip1014_job(const std::string &deployer, int feed_at)
+  {
+    create2_job job = create2_job();
+    eth_address d = address_from_hex(deployer);
+    memcpy(job.deployer, d.bytes, 20);
+    if (feed_at >= 0) {
+      job.salt[feed_at] = 0xfe;
+      job.salt[feed_at + 1] = 0xed;
+    }
+    unsigned char init_code = 0x00;
+    keccak256(job.init_code_hash, &init_code, 1);
+    return job;
+  }
+
+  void testCreate2Reference()
+  {
+    eth_address addr;
+    create2_address(addr, eip1014_job("0x0000000000000000000000000000000000000000", -1), 0);
+    TS_ASSERT_EQUALS(eth_address_to_string(addr), "0x4D1A2e2bB4F88F0250f26Ffff098B0b30B26BF38");
+
+    create2_address(addr, eip1014_job("0xdeadbeef00000000000000000000000000000000", -1), 0);
+    TS_ASSERT_EQUALS(eth_address_to_string(addr), "0xB928f69Bb1D91Cd65274e3c79d8986362984fDA3");
+
+    create2_address(addr, eip1014_job("0xdeadbeef00000000000000000000000000000000", 12), 0);
+    TS_ASSERT_EQUALS(eth_address_to_string(addr), "0xD04116cDd17beBE565EB2422F2497E06cC1C9833");
+  }
+
+  void testCreate2LanesMatchReference()
+  {
+    create2_job job = eip1014_job("0xdeadbeef00000000000000000000000000000000", 12);
+    create2_state s = create2_prepare(job);
+    uint64_t counters[] = {0, 0xFE, 0x00FFFFFFFFFFFFFEULL, 0x0123456789ABCDEFULL};
+    for(uint64_t c : counters)
+    {
+      eth_address lanes[KECCAK_LANES];
+      create2_address_x4(lanes, s, c);
+      for(int l = 0; l < KECCAK_LANES; l++)
+      {
+        eth_address ref;
+        create2_address(ref, job, c + l);
+        TS_ASSERT_SAME_DATA(lanes[l].bytes, ref.bytes, ETH_ADDRESS_SIZE);
+      }
+    }
+  }
+
+  void testCreate2SearchFindsPattern()
+  {
+    create2_job job = eip1014_job("0xdeadbeef00000000000000000000000000000000", -1);
+    eth_pattern p = eth_pattern_compile("0xBe", true);
+    create2_result res = create2_search(job, p, 1, 0, nullptr, nullptr);
+    TS_ASSERT(res.found);
+
+    eth_address ref;
+    create2_address(ref, job, res.counter);
+    TS_ASSERT_SAME_DATA(ref.bytes, res.address.bytes, ETH_ADDRESS_SIZE);
+    TS_ASSERT_EQUALS(eth_address_to_string(ref).substr(0, 4), "0xBe");
+  }
+
+  void testSplitKeyOffsetReconstructsKey()
+  {
+    secp256k1_scalar secret = {0, 0, 0, 0, 0, 0, 0x1234, 0x56789ABC};
+    secp256k1_point q = double_and_add(secret, SECP256K1_GENERATOR);
+
+    secp256k1_key_compressed key;
+    serialize_compressed(&key, &q, 1);
+
+    secp256k1_scalar start = {0, 0, 0, 0, 0, 0, 0, 1000};
+    splitkey_result res = splitkey_search(key, eth_pattern_compile("0xAb", true), 1, start, 64, nullptr, nullptr);
+    TS_ASSERT(res.found);
+
+    // the customer side: their secret plus our offset
+    secp256k1_point full = double_and_add(scalar_add(secret, res.offset), SECP256K1_GENERATOR);
+    TS_ASSERT(full.x == res.point.x && full.y == res.point.y);
+
+    secp256k1_key_uncompressed uncompressed;
+    serialize_uncompressed(&uncompressed, &full, 1);
+    eth_address addr;
+    eth_address_from_pubkey(addr, uncompressed.bytes + 1);
+    TS_ASSERT_EQUALS(eth_address_to_string(addr).substr(0, 4), "0xAb");
+  }
+
+  void testRandomKeySearchReturnsMatchingKey()
+  {
+    keysearch_options opt = keysearch_default_options();
+    opt.nthreads = 1;
+    opt.batch = 32;
+    opt.reseed_steps = 64;
+    opt.deterministic_seed = 5;
+
+    keysearch_result res = keysearch_random(eth_pattern_compile("0xc0", false), opt);
+    TS_ASSERT(res.found);
+
+    secp256k1_point pub = double_and_add(res.private_key, SECP256K1_GENERATOR);
+    secp256k1_key_uncompressed key;
+    serialize_uncompressed(&key, &pub, 1);
+    eth_address addr;
+    eth_address_from_pubkey(addr, key.bytes + 1);
+    TS_ASSERT_SAME_DATA(addr.bytes, res.address.bytes, ETH_ADDRESS_SIZE);
+    TS_ASSERT_EQUALS(addr.bytes[0], 0xc0);
+  }
+
+  // offset found by a single worker splitkey search resumed at steps from start
+  static splitkey_result resumed_splitkey(const secp256k1_key_compressed &key, const secp256k1_scalar &start, uint64_t steps)
+  {
+    checkpoint c = checkpoint();
+    c.workers.resize(1);
+    c.workers[0].base = start;
+    c.workers[0].steps = steps;
+    unsigned char extra[32] = {0};
+    checkpoint_publisher pub;
+    checkpoint_publisher_start(pub, checkpoint_options(), 1, extra, &c);
+    return splitkey_search(key, eth_pattern_compile("0xAb", true), 1, start, 64, &pub, nullptr);
+  }
+
+  void testCheckpointResumeNeitherRepeatsNorSkips()
+  {
+    secp256k1_scalar secret = {0, 0, 0, 0, 0, 0, 0x1234, 0x56789ABC};
+    secp256k1_point q = double_and_add(secret, SECP256K1_GENERATOR);
+    secp256k1_key_compressed key;
+    serialize_compressed(&key, &q, 1);
+    secp256k1_scalar start = {0, 0, 0, 0, 0, 0, 0, 1000};
+
+    splitkey_result first = resumed_splitkey(key, start, 0);
+    TS_ASSERT(first.found);
+    uint64_t d = first.offset.d[7] - 1000;
+
+    // resuming one step short of the hit finds it again, resuming right after it finds the next one
+    splitkey_result before = resumed_splitkey(key, start, d - 1);
+    TS_ASSERT(before.offset == first.offset);
+    splitkey_result after = resumed_splitkey(key, start, d);
+    TS_ASSERT(after.found);
+    TS_ASSERT(after.offset.d[6] > first.offset.d[6] || after.offset.d[7] > first.offset.d[7]);
+  }
+
+  void testCheckpointReplaysDeterministicStream()
+  {
+    keysearch_options opt = keysearch_default_options();
+    opt.nthreads = 1;
+    opt.batch = 32;
+    opt.reseed_steps = 64;
+    opt.deterministic_seed = 5;
+    eth_pattern p = eth_pattern_compile("0xc0", false);
+
+    unsigned char extra[32] = {0};
+    checkpoint_publisher pub;
+    checkpoint_publisher_start(pub, checkpoint_options(), 1, extra, nullptr);
+    opt.checkpoint = &pub;
+    keysearch_result first = keysearch_random(p, opt);
+    TS_ASSERT(first.found);
+
+    checkpoint c;
+    checkpoint_snapshot(pub, c);
+    TS_ASSERT_EQUALS(c.workers.size(), 1u);
+    TS_ASSERT(c.workers[0].draws > 0);
+
+    // back up to the start of the seed that hit, the same key comes out
+    c.workers[0].steps = 0;
+    checkpoint_publisher again;
+    checkpoint_publisher_start(again, checkpoint_options(), 1, extra, &c);
+    opt.checkpoint = &again;
+    keysearch_result second = keysearch_random(p, opt);
+    TS_ASSERT(second.found);
+    TS_ASSERT(second.private_key == first.private_key);
+  }
+
+  void testCheckpointFileRoundTrip()
+  {
+    char path[] = "/tmp/ckpt_testXXXXXX";
+    int fd = mkstemp(path);
+    TS_ASSERT(fd >= 0);
+    close(fd);
+
+    checkpoint c = checkpoint();
+    c.search_hash = 0x0123456789abcdefULL;
+    c.extra[0] = 0x42;
+    c.extra[31] = 0x17;
+    c.workers.resize(2);
+    c.workers[1].base = SECP256K1_ORDER;
+    c.workers[1].steps = 1ULL << 40;
+    c.workers[1].draws = 3;
+    c.workers[1].attempts = 12345;
+    checkpoint_save(c, path);
+
+    checkpoint r;
+    TS_ASSERT(checkpoint_load(r, path));
+    TS_ASSERT_EQUALS(r.search_hash, c.search_hash);
+    TS_ASSERT_SAME_DATA(r.extra, c.extra, 32);
+    TS_ASSERT_EQUALS(r.workers.size(), 2u);
+    TS_ASSERT(r.workers[1].base == SECP256K1_ORDER);
+    TS_ASSERT_EQUALS(r.workers[1].steps, 1ULL << 40);
+    TS_ASSERT_EQUALS(r.workers[1].draws, 3u);
+    TS_ASSERT_EQUALS(r.workers[1].attempts, 12345u);
+    TS_ASSERT_EQUALS(access((std::string(path) + ".tmp").c_str(), F_OK), -1);
+    remove(path);
+
+    TS_ASSERT(!checkpoint_load(r, path));
+  }
+
+  void testCheckpointLoadRejectsWrappingWorkerCount()
+  {
+    // the format error, not a failed allocation for the forged count
+    auto rejected = [](const char * path) {
+      checkpoint r;
+      try {
+        checkpoint_load(r, path);
+      } catch (std::runtime_error * e) {
+        delete e;
+        return true;
+      }
+      return false;
+    };
+    char path[] = "/tmp/ckpt_testXXXXXX";
+    int fd = mkstemp(path);
+    TS_ASSERT(fd >= 0);
+    close(fd);
+
+    checkpoint c = checkpoint();
+    c.workers.resize(1);
+    checkpoint_save(c, path);
+
+    // 2^61 + 1 workers of 56 bytes wrap around to the size of one
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(48 + 7);
+    f.put(0x20);
+    f.close();
+    TS_ASSERT(rejected(path));
+
+    // no workers at all
+    c.workers.clear();
+    checkpoint_save(c, path);
+    TS_ASSERT(rejected(path));
+    remove(path);
+  }
+
+  void testClusterRequeuesDeadWorkerAndVerifiesHit()
+  {
+    std::string address = "unix:/tmp/ecv_cluster_test_" + std::to_string(getpid()) + ".sock";
+    cluster_job job = cluster_job();
+    job.mode = CLUSTER_MODE_ETH;
+    job.pattern = "0xAb";
+    job.checksum_case = true;
+    cluster_options opt = cluster_default_options();
+    opt.listen = address;
+    opt.shard_steps = 4096;
+    opt.timeout = 5;
+    opt.origin = {0, 0, 0, 0, 0, 0, 0, 1000};
+
+    cluster_result res;
+    std::thread coordinator([&]() { res = cluster_coordinate(job, opt); });
+
+    // a worker that takes the first shard and dies without walking it
+    int fd = -1;
+    while (fd < 0) {
+      try {
+        fd = cluster_connect(address);
+      } catch (std::exception * e) {
+        delete e;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    cluster_message msg;
+    std::vector<unsigned char> hello = {'E', 'C', 'V', 'W', CLUSTER_VERSION, 0, 0, 0};
+    TS_ASSERT(cluster_send(fd, CLUSTER_HELLO, hello));
+    TS_ASSERT(cluster_recv(fd, msg));
+    TS_ASSERT_EQUALS(msg.type, CLUSTER_JOB);
+    TS_ASSERT(cluster_send(fd, CLUSTER_REQUEST, {}));
+    TS_ASSERT(cluster_recv(fd, msg));
+    TS_ASSERT_EQUALS(msg.type, CLUSTER_ASSIGN);
+    close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    cluster_work(address, 2, 64);
+    coordinator.join();
+
+    TS_ASSERT(res.found);
+    TS_ASSERT_EQUALS(res.reassigned, 1u);
+    TS_ASSERT(res.attempts > 0);
+    secp256k1_point pub = double_and_add(res.key, SECP256K1_GENERATOR);
+    secp256k1_key_uncompressed key;
+    serialize_uncompressed(&key, &pub, 1);
+    eth_address addr;
+    eth_address_from_pubkey(addr, key.bytes + 1);
+    TS_ASSERT_EQUALS(eth_address_to_string(addr).substr(0, 4), "0xAb");
+  }
+
+  void testClusterIsNotStalledByAClientThatStopsReading()
+  {
+    std::string address = "unix:/tmp/ecv_cluster_stall_" + std::to_string(getpid()) + ".sock";
+    cluster_job job = cluster_job();
+    job.mode = CLUSTER_MODE_ETH;
+    job.pattern = "0xab";
+    cluster_options opt = cluster_default_options();
+    opt.listen = address;
+    opt.shard_steps = 4096;
+    opt.timeout = 5;
+
+    cluster_result res;
+    std::thread coordinator([&]() { res = cluster_coordinate(job, opt); });
+    auto connect = [&]() {
+      for(;;)
+      {
+        try {
+          int fd = cluster_connect(address);
+          timeval tv = {5, 0};
+          setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+          return fd;
+        } catch (std::exception * e) {
+          delete e;
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+    };
+    std::vector<unsigned char> hello = {'E', 'C', 'V', 'W', CLUSTER_VERSION, 0, 0, 0};
+    cluster_message msg;
+
+    // no shard before HELLO
+    int early = connect();
+    TS_ASSERT(cluster_send(early, CLUSTER_REQUEST, {}));
+    TS_ASSERT(!cluster_recv(early, msg));
+    close(early);
+
+    // asks for shards without ever reading the answers
+    int stuck = connect();
+    TS_ASSERT(cluster_send(stuck, CLUSTER_HELLO, hello));
+    int flags = fcntl(stuck, F_GETFL);
+    fcntl(stuck, F_SETFL, flags | O_NONBLOCK);
+    for(int i = 0; i < 20000; i++)
+    {
+      cluster_send(stuck, CLUSTER_REQUEST, {});
+    }
+
+    int other = connect();
+    TS_ASSERT(cluster_send(other, CLUSTER_HELLO, hello));
+    TS_ASSERT(cluster_recv(other, msg));
+    TS_ASSERT_EQUALS(msg.type, CLUSTER_JOB);
+    TS_ASSERT(cluster_send(other, CLUSTER_REQUEST, {}));
+    TS_ASSERT(cluster_recv(other, msg));
+    TS_ASSERT_EQUALS(msg.type, CLUSTER_ASSIGN);
+    close(other);
+
+    cluster_work(address, 2, 64);
+    coordinator.join();
+    close(stuck);
+    TS_ASSERT(res.found);
+  }
+
+  void testResultSinkRejectsUnverifiedHit()
+  {
+    result_sink_options opt = result_sink_default_options();
+    secp256k1_scalar k = {0, 0, 0, 0, 0, 0, 0, 1};
+    result_record rec = {k, 0, address_from_hex("0x7e5f4552091a69125d5dfcb7b8c2659029395bdf")};
+    TS_ASSERT(result_verify(opt, rec));
+    TS_ASSERT_EQUALS(result_format_record(opt, rec),
+      "{\"address\":\"0x7E5F4552091A69125d5DfCb7b8C2659029395Bdf\",\"private_key\":\"" + std::string(63, '0') + "1\"}");
+    opt.format = RESULT_CSV;
+    TS_ASSERT_EQUALS(result_format_record(opt, rec), "0x7E5F4552091A69125d5DfCb7b8C2659029395Bdf," + std::string(63, '0') + "1");
+
+    rec.key.d[7] = 2;
+    TS_ASSERT(!result_verify(opt, rec));
+  }
+
+  void testResultSinkDropsHitsWhenTheRingIsFull()
+  {
+    // no writer thread, nothing drains the ring
+    result_sink sink;
+    sink.nworkers = 1;
+    sink.rings.reset(new result_ring[1]);
+    result_record rec = result_record();
+    for(size_t i = 0; i < RESULT_RING_SIZE + 5; i++)
+    {
+      rec.counter = i;
+      TS_ASSERT(!result_sink_push(sink, 0, rec));
+    }
+    TS_ASSERT_EQUALS(sink.rings[0].head.load(), RESULT_RING_SIZE);
+    TS_ASSERT_EQUALS(sink.rings[0].dropped, 5u);
+    TS_ASSERT_EQUALS(sink.rings[0].records[RESULT_RING_SIZE - 1].counter, RESULT_RING_SIZE - 1);
+  }
+
+  void testResultSinkWritesEveryHitOnce()
+  {
+    char path[] = "/tmp/sink_testXXXXXX";
+    int fd = mkstemp(path);
+    TS_ASSERT(fd >= 0);
+    close(fd);
+
+    result_sink_options sopt = result_sink_default_options();
+    sopt.path = path;
+    sopt.fsync_every = 4;
+    sopt.limit = 40;
+    result_sink sink;
+    result_sink_open(sink, sopt, 2);
+
+    keysearch_options opt = keysearch_default_options();
+    opt.nthreads = 2;
+    opt.batch = 64;
+    opt.deterministic_seed = 9;
+    opt.sink = &sink;
+    keysearch_random(eth_pattern_compile("0xa", false), opt);
+    result_sink_close(sink);
+    TS_ASSERT_EQUALS(sink.rejected, 0u);
+    TS_ASSERT_EQUALS(sink.written, 40u);
+
+    std::ifstream in(path);
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(in, line)) {
+      lines.push_back(line);
+    }
+    remove(path);
+    TS_ASSERT_EQUALS(lines.size(), sink.written);
+    for(const std::string &l : lines)
+    {
+      TS_ASSERT_EQUALS(l.substr(0, 14), "{\"address\":\"0x");
+      TS_ASSERT_EQUALS(tolower(l[14]), 'a');
+    }
+    std::sort(lines.begin(), lines.end());
+    TS_ASSERT(std::unique(lines.begin(), lines.end()) == lines.end());
+  }
+
+  void testArenaAlignsAndRefusesOverflow()
+  {
+    arena a;
+    arena_init(a, arena_bytes<secp256k1_key_compressed>(3) + arena_bytes<secp256k1_point>(2));
+    secp256k1_key_compressed * k = arena_array<secp256k1_key_compressed>(a, 3);
+    secp256k1_point * p = arena_array<secp256k1_point>(a, 2);
+    TS_ASSERT_EQUALS((uintptr_t)k % ARENA_ALIGN, 0u);
+    TS_ASSERT_EQUALS((uintptr_t)p % ARENA_ALIGN, 0u);
+    TS_ASSERT(point_is_infinity(p[1]));
+    TS_ASSERT_THROWS_ANYTHING(arena_alloc(a, 1));
+
+    // without reserved huge pages MAP_HUGETLB falls back to normal pages
+    arena_use_hugetlb(true);
+    arena big;
+    arena_init(big, ARENA_HUGE_PAGE + 1);
+    arena_use_hugetlb(false);
+    TS_ASSERT(big.size >= ARENA_HUGE_PAGE + 1);
+    unsigned char * b = (unsigned char *)arena_alloc(big, ARENA_HUGE_PAGE);
+    b[ARENA_HUGE_PAGE - 1] = 1;
+  }
+
+  void testSha256Vectors()
+  {
+    unsigned char h[32];
+    sha256(h, nullptr, 0);
+    TS_ASSERT_EQUALS(hex(h, 32), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sha256(h, (const unsigned char *)"abc", 3);
+    TS_ASSERT_EQUALS(hex(h, 32), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    // 56 bytes, the length no longer fits the first block
+    std::string two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha256(h, (const unsigned char *)two.data(), two.size());
+    TS_ASSERT_EQUALS(hex(h, 32), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  }
+
+  void testTaggedHashLanesMatchReference()
+  {
+    sha256_midstate mid = sha256_tagged_midstate("TapTweak");
+    uint32_t in[8][SHA256_LANES];
+    uint32_t out[8][SHA256_LANES];
+    for(int i = 0; i < 8; i++)
+    {
+      for(int l = 0; l < SHA256_LANES; l++) {
+        in[i][l] = 0x01020304u * (l + 1) + 0x11111111u * i;
+      }
+    }
+    sha256_tagged32_x8(out, mid, in);
+
+    for(int l = 0; l < SHA256_LANES; l++)
+    {
+      // the tagged hash spelled out: SHA256(SHA256(tag) || SHA256(tag) || m)
+      unsigned char buf[96];
+      sha256(buf, (const unsigned char *)"TapTweak", 8);
+      memcpy(buf + 32, buf, 32);
+      for(int i = 0; i < 32; i++) {
+        buf[64 + i] = in[i / 4][l] >> (24 - 8 * (i % 4));
+      }
+      unsigned char ref[32];
+      unsigned char tagged[32];
+      sha256(ref, buf, sizeof(buf));
+      sha256_tagged(tagged, mid, buf + 64, 32);
+      TS_ASSERT_SAME_DATA(tagged, ref, 32);
+      for(int i = 0; i < 32; i++) {
+        TS_ASSERT_EQUALS((unsigned char)(out[i / 4][l] >> (24 - 8 * (i % 4))), ref[i]);
+      }
+    }
+  }
+
+  void testTaprootBip86Vector()
+  {
+    // BIP86, m/86'/0'/0'/0/0 of the "abandon ... about" mnemonic
+    secp256k1_key_compressed key;
+    key.bytes[0] = 0x02;
+    for(int i = 0; i < 32; i++) {
+      key.bytes[1 + i] = std::stoul(std::string("cc8a4bc64d897bddc5fbc2f670f7a8ba0b386779106cf1223c6fc5d7cd6fc115").substr(2*i, 2), nullptr, 16);
+    }
+    secp256k1_point p;
+    TS_ASSERT(point_decompress(p, key));
+    secp256k1_point q;
+    TS_ASSERT(taproot_output_key(q, p));
+    secp256k1_key_compressed out;
+    serialize_compressed(&out, &q, 1);
+    TS_ASSERT_EQUALS(hex(out.bytes + 1, 32), "a60869f0dbcf1dc659c9cecbaf8050135ea9e8cdc487053f1dc6880949dc684c");
+    TS_ASSERT_EQUALS(taproot_address(q.x), "bc1p5cyxnuxmeuwuvkwfem96lqzszd02n6xdcjrs20cac6yqjjwudpxqkedrcr");
+
+    // the odd-y twin of the internal key has the same output key
+    secp256k1_point odd = {p.x, field_neg(p.y)};
+    secp256k1_point q2;
+    TS_ASSERT(taproot_output_key(q2, odd));
+    TS_ASSERT_EQUALS(q2.x, q.x);
+  }
+
+  void testTaprootAddressBip350Vector()
+  {
+    TS_ASSERT_EQUALS(taproot_address(SECP256K1_GENERATOR.x), "bc1p0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vqzk5jj0");
+  }
+
+  void testTaprootPatternCompile()
+  {
+    taproot_pattern p = taproot_pattern_compile("BC1P0X");
+    TS_ASSERT_EQUALS(p.nchars, 2);
+    TS_ASSERT(taproot_match(p, SECP256K1_GENERATOR.x));
+    TS_ASSERT(taproot_match(taproot_pattern_compile("0xlxvlhemja6c4"), SECP256K1_GENERATOR.x));
+    TS_ASSERT(!taproot_match(taproot_pattern_compile("bc1p0y"), SECP256K1_GENERATOR.x));
+    TS_ASSERT_DELTA(taproot_pattern_probability(p), 1.0 / 1024, 1e-15);
+
+    // b, i, o and 1 are not in the alphabet
+    TS_ASSERT_THROWS_ANYTHING(taproot_pattern_compile("bc1pb"));
+    TS_ASSERT_THROWS_ANYTHING(taproot_pattern_compile(std::string(TAPROOT_PATTERN_MAX_CHARS + 1, 'q')));
+  }
+
+  void testTaprootSearchReturnsSpendableKey()
+  {
+    taproot_options opt = taproot_default_options();
+    opt.nthreads = 2;
+    opt.batch = 20;
+    opt.reseed_steps = 200;
+    opt.deterministic_seed = 9;
+
+    taproot_result res = taproot_search(taproot_pattern_compile("bc1pqz"), opt);
+    TS_ASSERT(res.found);
+    TS_ASSERT_EQUALS(res.address.substr(0, 6), "bc1pqz");
+
+    secp256k1_point internal = double_and_add(res.private_key, SECP256K1_GENERATOR);
+    TS_ASSERT_EQUALS(internal.x, res.internal.x);
+    secp256k1_point q;
+    TS_ASSERT(taproot_output_key(q, internal));
+    TS_ASSERT_EQUALS(taproot_address(q.x), res.address);
+    // the key-path spending key belongs to the x-only output key
+    secp256k1_point spend = double_and_add(taproot_output_secret(res.private_key), SECP256K1_GENERATOR);
+    TS_ASSERT_EQUALS(spend.x, q.x);
+  }
+
+  void testPatternProbability()
+  {
+    TS_ASSERT_EQUALS(eth_pattern_probability(eth_pattern_compile("0xdead", false)), 1.0 / 65536);
+    TS_ASSERT_EQUALS(eth_pattern_probability(eth_pattern_compile("0xDead", true)), 1.0 / 65536 / 16);
+    TS_ASSERT_EQUALS(eth_pattern_probability(eth_pattern_compile("0x", true)), 1.0);
+  }
+
+  void testStatsReportCountsKeysAndEta()
+  {
+    std::unique_ptr<stats_snapshot> prev(new stats_snapshot());
+    std::unique_ptr<stats_snapshot> cur(new stats_snapshot());
+    prev->nthreads = cur->nthreads = 2;
+    prev->time = 10;
+    cur->time = 12;
+    prev->keys[0] = 100;
+    prev->keys[1] = 100;
+    cur->keys[0] = 300;
+    cur->keys[1] = 500;
+
+    std::string text = stats_format_prometheus(*cur, *prev, 1.0 / 3000);
+    TS_ASSERT(text.find("vanity_keys_total{thread=\"1\"} 500\n") != std::string::npos);
+    TS_ASSERT(text.find("vanity_keys_per_second{thread=\"0\"} 100.0\n") != std::string::npos);
+    // 300 keys/s in total, 3000 expected attempts
+    TS_ASSERT(text.find("vanity_eta_seconds 10.0\n") != std::string::npos);
+  }
+
+  void testDifficultyOfSinglePatternMatchesProbability()
+  {
+    eth_pattern p = eth_pattern_compile("0xDeAd0", true);
+    TS_ASSERT_DELTA(difficulty_probability({p}), eth_pattern_probability(p), 1e-18);
+  }
+
+  void testDifficultyOfPatternSetIsExactUnion()
+  {
+    // 0xde contains 0xdead, disjoint prefixes add up
+    eth_pattern de = eth_pattern_compile("0xde", false);
+    eth_pattern dead = eth_pattern_compile("0xdead", false);
+    eth_pattern beef = eth_pattern_compile("0xbeef", false);
+    TS_ASSERT_DELTA(difficulty_probability({de, dead}), 1.0 / 256, 1e-15);
+    TS_ASSERT_DELTA(difficulty_probability({dead, beef}), 2.0 / 65536, 1e-15);
+
+    // same nibbles with both cases cover the case-insensitive pattern
+    eth_pattern upper = eth_pattern_compile("0xA", true);
+    eth_pattern lower = eth_pattern_compile("0xa", true);
+    TS_ASSERT_DELTA(difficulty_probability({upper, lower}), 1.0 / 16, 1e-15);
+    TS_ASSERT_DELTA(difficulty_probability({upper}), 1.0 / 32, 1e-15);
+  }
+
+  void testDifficultyOfLongCaseInsensitivePattern()
+  {
+    // used to branch on the case of every letter, 2^40 paths
+    eth_pattern p = eth_pattern_compile("0x" + std::string(40, 'a'), false);
+    auto start = std::chrono::steady_clock::now();
+    double prob = difficulty_probability({p});
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TS_ASSERT_DELTA(prob / std::pow(16.0, -40), 1.0, 1e-12);
+    TS_ASSERT(seconds < 0.1);
+
+    eth_pattern cased = eth_pattern_compile("0x" + std::string(40, 'A'), true);
+    TS_ASSERT_DELTA(difficulty_probability({cased}) / std::pow(32.0, -40), 1.0, 1e-12);
+  }
+
+  void testDifficultyQuantiles()
+  {
+    difficulty_estimate e = difficulty_estimate_patterns({eth_pattern_compile("0xdead", false)});
+    TS_ASSERT_EQUALS(e.expected_attempts, 65536);
+    // median of a geometric distribution is about ln(2) / p
+    TS_ASSERT_DELTA(e.p50_attempts, 45426, 2);
+    TS_ASSERT(e.p90_attempts < e.p99_attempts);
+  }
+
+  void testTuneCacheRoundTrip()
+  {
+    std::string path = "/tmp/ec-vanity-address-tune-test";
+    remove(path.c_str());
+    tune_result a = {4, 512, 12345.5};
+    tune_result b = {8, 1024, 99.0};
+    tune_save(a, path, "cpu A x4");
+    tune_save(b, path, "cpu B x8");
+    tune_save(b, path, "cpu A x4");
+
+    tune_result r;
+    TS_ASSERT(tune_load(r, path, "cpu A x4"));
+    TS_ASSERT_EQUALS(r.nthreads, 8);
+    TS_ASSERT_EQUALS(r.batch, 1024);
+    TS_ASSERT(!tune_load(r, path, "cpu C x2"));
+    remove(path.c_str());
+  }
+};
@@ -0,0 +1,158 @@
+#include "keccak.h"
+#include <cstring>
+
+static const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+static const int KECCAK_ROTC[24] = {
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+    27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+static const int KECCAK_PILN[24] = {
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+    15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void keccakf1600(uint64_t st[25])
+{
+    uint64_t bc[5];
+    for(int round = 0; round < 24; round++)
+    {
+        // theta
+        for(int i = 0; i < 5; i++) {
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        }
+        for(int i = 0; i < 5; i++) {
+            uint64_t t = bc[(i + 4) % 5] ^ rotl64(bc[(i + 1) % 5], 1);
+            for(int j = 0; j < 25; j += 5) {
+                st[j + i] ^= t;
+            }
+        }
+
+        // rho and pi
+        uint64_t t = st[1];
+        for(int i = 0; i < 24; i++) {
+            int j = KECCAK_PILN[i];
+            uint64_t tmp = st[j];
+            st[j] = rotl64(t, KECCAK_ROTC[i]);
+            t = tmp;
+        }
+
+        // chi
+        for(int j = 0; j < 25; j += 5) {
+            for(int i = 0; i < 5; i++) {
+                bc[i] = st[j + i];
+            }
+            for(int i = 0; i < 5; i++) {
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+            }
+        }
+
+        // iota
+        st[0] ^= KECCAK_RC[round];
+    }
+}
+
+// Same permutation over KECCAK_LANES states at once, written so that every
+// step is an independent loop over the states and can be vectorised
+void keccakf1600_x4(uint64_t st[25][KECCAK_LANES])
+{
+    uint64_t bc[5][KECCAK_LANES];
+    for(int round = 0; round < 24; round++)
+    {
+        // theta
+        for(int i = 0; i < 5; i++) {
+            for(int l = 0; l < KECCAK_LANES; l++) {
+                bc[i][l] = st[i][l] ^ st[i + 5][l] ^ st[i + 10][l] ^ st[i + 15][l] ^ st[i + 20][l];
+            }
+        }
+        for(int i = 0; i < 5; i++) {
+            uint64_t t[KECCAK_LANES];
+            for(int l = 0; l < KECCAK_LANES; l++) {
+                t[l] = bc[(i + 4) % 5][l] ^ rotl64(bc[(i + 1) % 5][l], 1);
+            }
+            for(int j = 0; j < 25; j += 5) {
+                for(int l = 0; l < KECCAK_LANES; l++) {
+                    st[j + i][l] ^= t[l];
+                }
+            }
+        }
+
+        // rho and pi
+        uint64_t t[KECCAK_LANES];
+        for(int l = 0; l < KECCAK_LANES; l++) {
+            t[l] = st[1][l];
+        }
+        for(int i = 0; i < 24; i++) {
+            int j = KECCAK_PILN[i];
+            for(int l = 0; l < KECCAK_LANES; l++) {
+                uint64_t tmp = st[j][l];
+                st[j][l] = rotl64(t[l], KECCAK_ROTC[i]);
+                t[l] = tmp;
+            }
+        }
+
+        // chi
+        for(int j = 0; j < 25; j += 5) {
+            for(int i = 0; i < 5; i++) {
+                for(int l = 0; l < KECCAK_LANES; l++) {
+                    bc[i][l] = st[j + i][l];
+                }
+            }
+            for(int i = 0; i < 5; i++) {
+                for(int l = 0; l < KECCAK_LANES; l++) {
+                    st[j + i][l] ^= (~bc[(i + 1) % 5][l]) & bc[(i + 2) % 5][l];
+                }
+            }
+        }
+
+        // iota
+        for(int l = 0; l < KECCAK_LANES; l++) {
+            st[0][l] ^= KECCAK_RC[round];
+        }
+    }
+}
+
+// lanes are little endian, which matches the memory layout on x86
+static void keccak_absorb_block(uint64_t st[25], const unsigned char * block)
+{
+    for(int i = 0; i < KECCAK256_RATE / 8; i++) {
+        uint64_t lane;
+        memcpy(&lane, block + 8*i, sizeof(lane));
+        st[i] ^= lane;
+    }
+    keccakf1600(st);
+}
+
+void keccak256(unsigned char out[32], const unsigned char * in, size_t len)
+{
+    uint64_t st[25] = {0};
+
+    while (len >= KECCAK256_RATE) {
+        keccak_absorb_block(st, in);
+        in += KECCAK256_RATE;
+        len -= KECCAK256_RATE;
+    }
+
+    unsigned char last[KECCAK256_RATE] = {0};
+    memcpy(last, in, len);
+    last[len] ^= 0x01;
+    last[KECCAK256_RATE - 1] ^= 0x80;
+    keccak_absorb_block(st, last);
+
+    memcpy(out, st, 32);
+}
@@ -0,0 +1,18 @@
+#include <cstdint>
+#include <cstddef>
+
+#ifndef KECCAK_H
+#define KECCAK_H
+
+// Keccak-256 as used by Ethereum (original Keccak padding, not FIPS-202 SHA3)
+const int KECCAK256_RATE = 136;
+
+// number of independent states permuted together by keccakf1600_x4
+const int KECCAK_LANES = 4;
+
+void keccakf1600(uint64_t st[25]);
+// lane-interleaved states: st[i][l] is lane i of state l
+void keccakf1600_x4(uint64_t st[25][KECCAK_LANES]);
+void keccak256(unsigned char out[32], const unsigned char * in, size_t len);
+
+#endif
@@ -0,0 +1,152 @@
+#include "keysearch.h"
+#include "aesctr.h"
+#include <algorithm>
+#include <mutex>
+
+void keysearch_walker_init(keysearch_walker &w, const secp256k1_point * table, size_t batch)
+{
+    w.table = table;
+    w.batch = batch;
+    arena_init(w.mem, arena_bytes<secp256k1_point>(batch) + arena_bytes<secp256k1_scalar>(2 * batch)
+        + arena_bytes<secp256k1_key_uncompressed>(batch));
+    w.points = arena_array<secp256k1_point>(w.mem, batch);
+    w.scratch = arena_array<secp256k1_scalar>(w.mem, 2 * batch);
+    w.keys = arena_array<secp256k1_key_uncompressed>(w.mem, batch);
+}
+
+uint64_t keysearch_walk(keysearch_walker &w, const secp256k1_point &start, const eth_pattern &p,
+    search_control &ctl, uint64_t max_steps, keysearch_hit &hit)
+{
+    secp256k1_point base = start;
+    eth_address addr;
+    uint64_t steps = 0;
+    hit.found = false;
+
+    while (steps < max_steps && !ctl.stop) {
+        STATS_TIMER_START(t_step);
+        point_add_batch(w.points, base, w.table, w.batch, w.scratch);
+        STATS_TIMER_STOP(t_step, STATS_STAGE_STEP);
+
+        STATS_TIMER_START(t_serialize);
+        serialize_uncompressed(w.keys, w.points, w.batch);
+        STATS_TIMER_STOP(t_serialize, STATS_STAGE_SERIALIZE);
+
+        STATS_TIMER_START(t_hash);
+        for(size_t i = 0; i < w.batch; i++)
+        {
+            eth_address_from_pubkey(addr, w.keys[i].bytes + 1);
+            if (eth_match(p, addr)) {
+                STATS_TIMER_STOP(t_hash, STATS_STAGE_HASH);
+                hit.found = true;
+                hit.step = steps + i;
+                hit.point = w.points[i];
+                hit.address = addr;
+                w.last = w.points[i];
+                search_count(ctl, i + 1);
+                return steps + i + 1;
+            }
+        }
+        STATS_TIMER_STOP(t_hash, STATS_STAGE_HASH);
+
+        base = w.points[w.batch - 1];
+        steps += w.batch;
+        search_count(ctl, w.batch);
+    }
+    w.last = base;
+    return steps;
+}
+
+keysearch_options keysearch_default_options()
+{
+    keysearch_options opt = keysearch_options();
+    opt.nthreads = search_default_threads();
+    opt.batch = 256;
+    opt.reseed_steps = (uint64_t)1 << 32;
+    opt.deterministic_seed = 0;
+    opt.checkpoint = nullptr;
+    opt.sink = nullptr;
+    return opt;
+}
+
+keysearch_result keysearch_random(const eth_pattern &p, const keysearch_options &opt)
+{
+    std::vector<secp256k1_point> table(opt.batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, opt.batch);
+
+    keysearch_result res = keysearch_result();
+    std::mutex res_lock;
+    search_control ctl;
+
+    search_run(opt.nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        // a worker's state is its current seed and the steps walked from it,
+        // a deterministic stream is replayed up to the number of seeds drawn
+        checkpoint_worker state = checkpoint_worker();
+        checkpoint_resume(opt.checkpoint, worker, state);
+
+        aes_stream rng;
+        if (opt.deterministic_seed) {
+            aes_stream_seed_deterministic(rng, opt.deterministic_seed, worker);
+            for(uint64_t i = 0; i < state.draws; i++)
+            {
+                aes_stream_scalar(rng);
+            }
+        } else {
+            aes_stream_seed_random(rng);
+        }
+
+        keysearch_walker w;
+        keysearch_walker_init(w, table.data(), opt.batch);
+        keysearch_hit hit;
+
+        secp256k1_point start = SECP256K1_INFINITY;
+        bool walking = false;
+        while (!ctl.stop) {
+            if (state.draws == 0 || state.steps >= opt.reseed_steps) {
+                state.base = aes_stream_scalar(rng);
+                state.draws++;
+                state.steps = 0;
+                walking = false;
+            }
+            if (!walking) {
+                start = double_and_add<const_time>(scalar_add<const_time>(state.base, scalar_from_uint64(state.steps)),
+                    SECP256K1_GENERATOR);
+                walking = true;
+            }
+
+            uint64_t from = state.steps;
+            uint64_t chunk = std::min(KEYSEARCH_CHUNK_STEPS, opt.reseed_steps - state.steps);
+            uint64_t n = keysearch_walk(w, start, p, ctl, chunk, hit);
+            start = w.last;
+            state.steps += n;
+            state.attempts += n;
+            if (opt.checkpoint) {
+                checkpoint_publish(*opt.checkpoint, worker, state);
+            }
+            if (opt.sink && result_sink_full(*opt.sink)) {
+                ctl.stop = true;
+            }
+            if (!hit.found) {
+                continue;
+            }
+
+            secp256k1_scalar key = scalar_add<const_time>(state.base, scalar_from_uint64(from + hit.step + 1));
+            if (opt.sink) {
+                result_record rec = {key, 0, hit.address};
+                if (result_sink_push(*opt.sink, worker, rec)) {
+                    ctl.stop = true;
+                }
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(res_lock);
+            if (!res.found) {
+                res.found = true;
+                res.private_key = key;
+                res.point = hit.point;
+                res.address = hit.address;
+            }
+            ctl.stop = true;
+        }
+    });
+    return res;
+}
@@ -0,0 +1,76 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "secp256k1.h"
+#include "ethaddress.h"
+#include "search.h"
+#include "arena.h"
+#include "checkpoint.h"
+#include "resultsink.h"
+
+#ifndef KEYSEARCH_H
+#define KEYSEARCH_H
+
+// A found key is reported relative to the point the walk started from:
+// point = start + (step + 1)G, where step counts from the start of the walk.
+struct keysearch_hit
+{
+    bool found;
+    uint64_t step;
+    secp256k1_point point;
+    eth_address address;
+};
+
+// Per-thread buffers for the batched walk, table is the shared (i + 1)G step table.
+// The buffers are carved out of one arena when the walker is set up, the walk
+// itself does not allocate. A smaller batch may be walked over the same buffers
+// by lowering batch, the table prefix is the matching step table.
+struct keysearch_walker
+{
+    const secp256k1_point * table;
+    size_t batch;
+    arena mem;
+    secp256k1_point * points;
+    secp256k1_scalar * scratch;
+    secp256k1_key_uncompressed * keys;
+    // where the last walk stopped, start + steps * G
+    secp256k1_point last;
+};
+
+void keysearch_walker_init(keysearch_walker &w, const secp256k1_point * table, size_t batch);
+
+// Walks start + G, start + 2G, ... matching Ethereum addresses until a hit,
+// ctl.stop or max_steps (rounded up to whole batches). Returns the steps taken.
+// Long walks are split into chunks of KEYSEARCH_CHUNK_STEPS, continuing from
+// w.last, so that progress can be published in between.
+uint64_t keysearch_walk(keysearch_walker &w, const secp256k1_point &start, const eth_pattern &p,
+    search_control &ctl, uint64_t max_steps, keysearch_hit &hit);
+
+const uint64_t KEYSEARCH_CHUNK_STEPS = (uint64_t)1 << 16;
+
+struct keysearch_options
+{
+    int nthreads;
+    size_t batch;
+    // steps walked from one random seed before drawing a new one
+    uint64_t reseed_steps;
+    // 0 seeds every thread from getrandom(), otherwise streams are reproducible
+    uint64_t deterministic_seed;
+    // optional, workers publish their progress to it and resume from it
+    checkpoint_publisher * checkpoint;
+    // optional, every hit goes to the sink and the search runs on until its limit
+    result_sink * sink;
+};
+
+struct keysearch_result
+{
+    bool found;
+    secp256k1_scalar private_key;
+    secp256k1_point point;
+    eth_address address;
+};
+
+keysearch_options keysearch_default_options();
+keysearch_result keysearch_random(const eth_pattern &p, const keysearch_options &opt);
+
+#endif
@@ -0,0 +1,513 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "secp256k1.h"
+#include "ethaddress.h"
+#include "create2.h"
+#include "splitkey.h"
+#include "keysearch.h"
+#include "aesctr.h"
+#include "stats.h"
+#include "difficulty.h"
+#include "tune.h"
+#include "checkpoint.h"
+#include "cluster.h"
+#include "resultsink.h"
+#include "taproot.h"
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void usage()
+{
+    cerr << "usage:" << endl;
+    cerr << "  main eth <pattern> [options]" << endl;
+    cerr << "  main create2 <deployer> <init_code_hash> <pattern> [options]" << endl;
+    cerr << "  main splitkey <compressed_pubkey> <pattern> [options]" << endl;
+    cerr << "  main taproot <bc1p_prefix> [-t <threads>] [-b <batch>] [--seed <n>] [--stats <s>] [--stats-out <target>] [--hugepages]" << endl;
+    cerr << "  main serve <listen> eth <pattern> [-c] [--shard <steps>] [--timeout <s>]" << endl;
+    cerr << "  main serve <listen> splitkey <compressed_pubkey> <pattern> [-c] [--shard <steps>] [--timeout <s>]" << endl;
+    cerr << "  main work <coordinator> [-t <threads>] [-b <batch>] [--hugepages]" << endl;
+    cerr << "  main derive <private_keys_file> <public_keys_file> [-u] [-t <threads>]" << endl;
+    cerr << "options:" << endl;
+    cerr << "  -t <threads>   worker threads (default: autotuned)" << endl;
+    cerr << "  -b <batch>     points per batch inversion (default: autotuned)" << endl;
+    cerr << "  -c             match letter case against the EIP-55 checksum" << endl;
+    cerr << "  --seed <n>     deterministic seed streams, for benchmarks only" << endl;
+    cerr << "  --retune       redo the autotuning instead of using the cached result" << endl;
+    cerr << "  --no-tune      skip autotuning, use all cores and a batch of 256" << endl;
+    cerr << "  --stats <s>    report counters every s seconds in Prometheus text format" << endl;
+    cerr << "  --stats-out <target>  - for stderr (default), unix:<path> or a file path" << endl;
+    cerr << "  --checkpoint <file>   save progress to file, resume from it if it exists" << endl;
+    cerr << "  --checkpoint-interval <s>  seconds between checkpoints (default 60)" << endl;
+    cerr << "  --hugepages    put batch buffers of 2 MB and more on reserved huge pages (MAP_HUGETLB)" << endl;
+    cerr << "  --count <n>    keep searching and write every hit until n are found (0: no limit)" << endl;
+    cerr << "  --out <file>   append hits to file instead of stdout (with --count)" << endl;
+    cerr << "  --format <f>   ndjson (default) or csv (with --count)" << endl;
+    cerr << "  --fsync-every <n>  sync the output after n hits (default 1000)" << endl;
+    cerr << "taproot prints the internal private key, the key of a tr(KEY) descriptor" << endl;
+    cerr << "derive reads 32 byte big-endian private keys and writes 33 byte (-u: 65 byte) public keys" << endl;
+    cerr << "addresses for serve and work are unix:<path> or <host>:<port>" << endl;
+}
+
+// everything that has to be equal for a checkpoint to continue the same search
+static uint64_t search_hash(const std::string &mode, const eth_pattern &p, char ** positional, int npositional,
+    uint64_t deterministic_seed)
+{
+    uint64_t h = checkpoint_hash(CHECKPOINT_HASH_INIT, mode.data(), mode.size());
+    h = checkpoint_hash_pattern(h, p);
+    for(int i = 0; i < npositional - 1; i++)
+    {
+        h = checkpoint_hash(h, positional[i], strlen(positional[i]));
+    }
+    return checkpoint_hash(h, &deterministic_seed, sizeof(deterministic_seed));
+}
+
+static void parse_hex(unsigned char * out, size_t n, std::string s)
+{
+    if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s = s.substr(2);
+    }
+    if (s.size() != 2 * n) {
+        throw new std::runtime_error("Hex argument has the wrong length");
+    }
+    if (s.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        throw new std::runtime_error("Hex argument contains a character that is not a hex digit");
+    }
+    for(size_t i = 0; i < n; i++)
+    {
+        out[i] = std::stoul(s.substr(2*i, 2), nullptr, 16);
+    }
+}
+
+static uint64_t parse_uint(const std::string &s, const std::string &option)
+{
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) {
+        throw new std::runtime_error(option + " expects a non-negative integer");
+    }
+    errno = 0;
+    uint64_t v = strtoull(s.c_str(), nullptr, 10);
+    if (errno == ERANGE) {
+        throw new std::runtime_error(option + " is out of range");
+    }
+    return v;
+}
+
+static double parse_seconds(const std::string &s, const std::string &option)
+{
+    size_t end = 0;
+    double v = 0;
+    try {
+        v = std::stod(s, &end);
+    } catch (const std::exception &) {
+        end = 0;
+    }
+    if (end == 0 || end != s.size() || !(v >= 0)) {
+        throw new std::runtime_error(option + " expects a number of seconds");
+    }
+    return v;
+}
+
+// thread counts and batch sizes, the workers index their last point and
+// size per-thread state by these so 0 is rejected before anything starts
+static int parse_at_least_one(const std::string &s, const std::string &option)
+{
+    uint64_t v = parse_uint(s, option);
+    if (v < 1 || v > INT_MAX) {
+        throw new std::runtime_error(option + " expects a value of at least 1");
+    }
+    return v;
+}
+
+static std::string to_hex(const unsigned char * d, size_t n)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string res;
+    for(size_t i = 0; i < n; i++)
+    {
+        res += digits[d[i] >> 4];
+        res += digits[d[i] & 0xF];
+    }
+    return res;
+}
+
+static std::string scalar_to_hex(const secp256k1_scalar &a)
+{
+    unsigned char bytes[32];
+    for(int i = 0; i < 32; i++)
+    {
+        bytes[i] = a.d[i / 4] >> (24 - 8 * (i % 4));
+    }
+    return to_hex(bytes, 32);
+}
+
+// coordinator: hands out shards of the key space and prints the verified hit
+static int serve_main(int argc, char ** argv)
+{
+    cluster_job job = cluster_job();
+    cluster_options opt = cluster_default_options();
+    opt.listen = argv[2];
+    std::string mode = argv[3];
+    int first_option = 5;
+    if (mode == "eth") {
+        job.mode = CLUSTER_MODE_ETH;
+        job.pattern = argv[4];
+    } else if (mode == "splitkey" && argc >= 6) {
+        job.mode = CLUSTER_MODE_SPLITKEY;
+        parse_hex(job.customer.bytes, sizeof(job.customer.bytes), argv[4]);
+        job.pattern = argv[5];
+        first_option = 6;
+    } else {
+        usage();
+        return 1;
+    }
+    for(int i = first_option; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-c") {
+            job.checksum_case = true;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            opt.shard_steps = parse_uint(argv[++i], arg);
+            if (opt.shard_steps < 1) {
+                throw new std::runtime_error("--shard expects a value of at least 1");
+            }
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            opt.timeout = parse_seconds(argv[++i], arg);
+            if (opt.timeout == 0) {
+                throw new std::runtime_error("--timeout expects a positive number of seconds");
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    aes_stream rng;
+    aes_stream_seed_random(rng);
+    opt.origin = aes_stream_scalar(rng);
+
+    cerr << difficulty_report(difficulty_estimate_patterns({eth_pattern_compile(job.pattern, job.checksum_case)}), 0);
+    cluster_result res = cluster_coordinate(job, opt);
+    cerr << "attempts: " << res.attempts << ", shards reassigned: " << res.reassigned << endl;
+    cout << "address: " << eth_address_to_string(res.address) << endl;
+    cout << (job.mode == CLUSTER_MODE_ETH ? "private key: " : "offset:  ") << scalar_to_hex(res.key) << endl;
+    return 0;
+}
+
+static int work_main(int argc, char ** argv)
+{
+    int nthreads = search_default_threads();
+    size_t batch = 256;
+    for(int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            nthreads = parse_at_least_one(argv[++i], arg);
+        } else if (arg == "-b" && i + 1 < argc) {
+            batch = parse_at_least_one(argv[++i], arg);
+        } else if (arg == "--hugepages") {
+            arena_use_hugetlb(true);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    cluster_work(argv[2], nthreads, batch);
+    return 0;
+}
+
+static int derive_main(int argc, char ** argv)
+{
+    int nthreads = search_default_threads();
+    bool compressed = true;
+    for(int i = 4; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-u") {
+            compressed = false;
+        } else if (arg == "-t" && i + 1 < argc) {
+            nthreads = parse_at_least_one(argv[++i], arg);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    size_t n = derive_pubkeys_file(argv[2], argv[3], compressed, nthreads);
+    cerr << n << " public keys written to " << argv[3] << endl;
+    return 0;
+}
+
+// bc1p key-path addresses, the tweak per candidate makes these far slower than
+// the Ethereum modes so the tuned parameters are not used
+static int taproot_main(int argc, char ** argv)
+{
+    taproot_options opt = taproot_default_options();
+    stats_report_options stats_opt = {0, "-", 0};
+    for(int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            opt.nthreads = parse_at_least_one(argv[++i], arg);
+        } else if (arg == "-b" && i + 1 < argc) {
+            opt.batch = parse_at_least_one(argv[++i], arg);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            opt.deterministic_seed = parse_uint(argv[++i], arg);
+        } else if (arg == "--stats" && i + 1 < argc) {
+            stats_opt.interval = parse_seconds(argv[++i], arg);
+        } else if (arg == "--stats-out" && i + 1 < argc) {
+            stats_opt.target = argv[++i];
+        } else if (arg == "--hugepages") {
+            arena_use_hugetlb(true);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    taproot_pattern p = taproot_pattern_compile(argv[2]);
+    cerr << difficulty_report(difficulty_estimate_probability(taproot_pattern_probability(p)), 0);
+
+    stats_reporter reporter;
+    if (stats_opt.interval > 0) {
+        stats_opt.probability = taproot_pattern_probability(p);
+        stats_reporter_start(reporter, stats_opt);
+    }
+    taproot_result res = taproot_search(p, opt);
+    stats_reporter_stop(reporter);
+
+    secp256k1_key_compressed internal;
+    serialize_compressed(&internal, &res.internal, 1);
+    cout << "address:      " << res.address << endl;
+    cout << "internal key: " << to_hex(internal.bytes + 1, 32) << endl;
+    cout << "output key:   " << scalar_to_hex(res.output.x) << endl;
+    cout << "private key:  " << scalar_to_hex(res.private_key) << endl;
+    return 0;
+}
+
+// eth, create2 and splitkey searches
+static int search_main(int argc, char ** argv)
+{
+    std::string mode = argv[1];
+    int npositional = mode == "create2" ? 3 : (mode == "splitkey" ? 2 : 1);
+    // checked before the autotuner and the difficulty report run
+    if ((mode != "eth" && mode != "create2" && mode != "splitkey") || argc < 2 + npositional) {
+        usage();
+        return 1;
+    }
+
+    keysearch_options opt = keysearch_default_options();
+    bool checksum_case = false;
+    stats_report_options stats_opt = {0, "-", 0};
+    bool threads_given = false;
+    bool batch_given = false;
+    bool retune = false;
+    bool no_tune = false;
+    checkpoint_options ckpt_opt = {"", 60, 0};
+    result_sink_options sink_opt = result_sink_default_options();
+    bool to_sink = false;
+    for(int i = 2 + npositional; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-c") {
+            checksum_case = true;
+        } else if (arg == "-t" && i + 1 < argc) {
+            opt.nthreads = parse_at_least_one(argv[++i], arg);
+            threads_given = true;
+        } else if (arg == "-b" && i + 1 < argc) {
+            opt.batch = parse_at_least_one(argv[++i], arg);
+            batch_given = true;
+        } else if (arg == "--retune") {
+            retune = true;
+        } else if (arg == "--no-tune") {
+            no_tune = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            opt.deterministic_seed = parse_uint(argv[++i], arg);
+        } else if (arg == "--stats" && i + 1 < argc) {
+            stats_opt.interval = parse_seconds(argv[++i], arg);
+        } else if (arg == "--stats-out" && i + 1 < argc) {
+            stats_opt.target = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            ckpt_opt.path = argv[++i];
+        } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            ckpt_opt.interval = parse_seconds(argv[++i], arg);
+        } else if (arg == "--hugepages") {
+            arena_use_hugetlb(true);
+        } else if (arg == "--count" && i + 1 < argc) {
+            sink_opt.limit = parse_uint(argv[++i], arg);
+            to_sink = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            sink_opt.path = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string f = argv[++i];
+            if (f != "csv" && f != "ndjson") {
+                usage();
+                return 1;
+            }
+            sink_opt.format = f == "csv" ? RESULT_CSV : RESULT_NDJSON;
+        } else if (arg == "--fsync-every" && i + 1 < argc) {
+            sink_opt.fsync_every = parse_uint(argv[++i], arg);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::string pattern = argv[1 + npositional];
+    eth_pattern p = eth_pattern_compile(pattern, checksum_case);
+
+    // a resumed search keeps the worker layout of the checkpoint
+    checkpoint resume;
+    bool resuming = !ckpt_opt.path.empty() && checkpoint_load(resume, ckpt_opt.path);
+    ckpt_opt.search_hash = search_hash(mode, p, argv + 2, npositional, opt.deterministic_seed);
+    if (resuming) {
+        if (resume.search_hash != ckpt_opt.search_hash) {
+            throw new std::runtime_error("Checkpoint belongs to a different search");
+        }
+        if (threads_given && opt.nthreads != (int)resume.workers.size()) {
+            throw new std::runtime_error("Checkpoint was written with a different thread count");
+        }
+        opt.nthreads = resume.workers.size();
+        threads_given = true;
+        uint64_t attempts = 0;
+        for(const checkpoint_worker &w : resume.workers)
+        {
+            attempts += w.attempts;
+        }
+        cerr << "resuming from " << ckpt_opt.path << " after " << attempts << " attempts" << endl;
+    }
+
+    // create2 does no curve arithmetic, the tuned parameters do not apply to it
+    double rate = 0;
+    bool key_mode = mode != "create2";
+    if (key_mode && !no_tune && !(threads_given && batch_given)) {
+        tune_result t = tune_cached(retune, 0.3);
+        if (!threads_given) opt.nthreads = t.nthreads;
+        if (!batch_given) opt.batch = t.batch;
+        if (!threads_given && !batch_given) rate = t.keys_per_sec;
+        cerr << "autotune: " << t.nthreads << " threads, batch " << t.batch << endl;
+    }
+    cerr << difficulty_report(difficulty_estimate_patterns({p}), rate);
+
+    stats_reporter reporter;
+    if (stats_opt.interval > 0) {
+        stats_opt.probability = eth_pattern_probability(p);
+        stats_reporter_start(reporter, stats_opt);
+    }
+
+    unsigned char extra[32] = {0};
+    checkpoint_publisher ckpt;
+    // with --count the hits are written by the sink instead of printed here
+    result_sink sink;
+    result_sink * hits = to_sink ? &sink : nullptr;
+
+    if (mode == "eth") {
+        checkpoint_publisher_start(ckpt, ckpt_opt, opt.nthreads, extra, resuming ? &resume : nullptr);
+        opt.checkpoint = &ckpt;
+        if (hits) {
+            result_sink_open(sink, sink_opt, opt.nthreads);
+            opt.sink = hits;
+        }
+        keysearch_result res = keysearch_random(p, opt);
+        checkpoint_publisher_stop(ckpt);
+        if (hits) {
+            result_sink_close(sink);
+        } else {
+            cout << "address:     " << eth_address_to_string(res.address) << endl;
+            cout << "private key: " << scalar_to_hex(res.private_key) << endl;
+        }
+    } else if (mode == "create2") {
+        create2_job job = create2_job();
+        parse_hex(job.deployer, sizeof(job.deployer), argv[2]);
+        parse_hex(job.init_code_hash, sizeof(job.init_code_hash), argv[3]);
+
+        // random salt template so that separate runs cover separate salts
+        aes_stream rng;
+        if (opt.deterministic_seed) {
+            aes_stream_seed_deterministic(rng, opt.deterministic_seed, 0);
+        } else {
+            aes_stream_seed_random(rng);
+        }
+        aes_stream_fill(rng, job.salt, 24);
+        if (resuming) {
+            memcpy(job.salt, resume.extra, sizeof(job.salt));
+        }
+
+        checkpoint_publisher_start(ckpt, ckpt_opt, opt.nthreads, job.salt, resuming ? &resume : nullptr);
+        if (hits) {
+            sink_opt.kind = RESULT_CREATE2_SALT;
+            sink_opt.job = job;
+            result_sink_open(sink, sink_opt, opt.nthreads);
+        }
+        create2_result res = create2_search(job, p, opt.nthreads, 0, &ckpt, hits);
+        checkpoint_publisher_stop(ckpt);
+        if (hits) {
+            result_sink_close(sink);
+        } else {
+            cout << "address: " << eth_address_to_string(res.address) << endl;
+            cout << "salt:    0x" << to_hex(res.salt, 32) << endl;
+        }
+    } else if (mode == "splitkey") {
+        secp256k1_key_compressed key;
+        parse_hex(key.bytes, sizeof(key.bytes), argv[2]);
+
+        aes_stream rng;
+        aes_stream_seed_random(rng);
+        secp256k1_scalar start = aes_stream_scalar(rng);
+
+        checkpoint_publisher_start(ckpt, ckpt_opt, opt.nthreads, extra, resuming ? &resume : nullptr);
+        if (hits) {
+            sink_opt.kind = RESULT_SPLITKEY_OFFSET;
+            if (!point_decompress(sink_opt.customer, key)) {
+                throw new std::runtime_error("Customer key is not a valid compressed point");
+            }
+            result_sink_open(sink, sink_opt, opt.nthreads);
+        }
+        splitkey_result res = splitkey_search(key, p, opt.nthreads, start, opt.batch, &ckpt, hits);
+        checkpoint_publisher_stop(ckpt);
+        if (hits) {
+            result_sink_close(sink);
+        } else {
+            cout << "address: " << eth_address_to_string(res.address) << endl;
+            cout << "offset:  " << scalar_to_hex(res.offset) << endl;
+        }
+    }
+    stats_reporter_stop(reporter);
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    try {
+        if (command == "serve" && argc >= 5) {
+            return serve_main(argc, argv);
+        }
+        if (command == "work") {
+            return work_main(argc, argv);
+        }
+        if (command == "derive" && argc >= 4) {
+            return derive_main(argc, argv);
+        }
+        if (command == "taproot") {
+            return taproot_main(argc, argv);
+        }
+        return search_main(argc, argv);
+    } catch (std::exception * e) {
+        cerr << "error: " << e->what() << endl;
+        delete e;
+        return 1;
+    } catch (const std::exception &e) {
+        // the standard library throws by value, e.g. std::bad_alloc or std::system_error
+        cerr << "error: " << e.what() << endl;
+        return 1;
+    }
+}
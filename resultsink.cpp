@@ -0,0 +1,238 @@
+#include "resultsink.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t RESULT_BUFFER_SIZE = 64 * 1024;
+
+static std::string to_hex(const unsigned char * d, size_t n)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string res;
+    for(size_t i = 0; i < n; i++)
+    {
+        res += digits[d[i] >> 4];
+        res += digits[d[i] & 0xF];
+    }
+    return res;
+}
+
+static std::string scalar_to_hex(const secp256k1_scalar &a)
+{
+    unsigned char bytes[32];
+    for(int i = 0; i < 32; i++)
+    {
+        bytes[i] = a.d[i / 4] >> (24 - 8 * (i % 4));
+    }
+    return to_hex(bytes, 32);
+}
+
+result_sink_options result_sink_default_options()
+{
+    result_sink_options opt = result_sink_options();
+    opt.path = "-";
+    opt.format = RESULT_NDJSON;
+    opt.fsync_every = 1000;
+    opt.limit = 0;
+    opt.kind = RESULT_ETH_KEY;
+    return opt;
+}
+
+// independent of the batched walk: one comb multiplication per hit, the
+// const_time comb also gets keys outside [1, n) right
+bool result_verify(const result_sink_options &opt, const result_record &rec)
+{
+    eth_address addr;
+    if (opt.kind == RESULT_CREATE2_SALT) {
+        create2_address(addr, opt.job, rec.counter);
+    } else {
+        secp256k1_point pt = generator_mult<const_time>(rec.key);
+        if (opt.kind == RESULT_SPLITKEY_OFFSET) {
+            pt = point_add<const_time>(opt.customer, pt);
+        }
+        if (point_is_infinity(pt)) {
+            return false;
+        }
+        secp256k1_key_uncompressed key;
+        serialize_uncompressed(&key, &pt, 1);
+        eth_address_from_pubkey(addr, key.bytes + 1);
+    }
+    return memcmp(addr.bytes, rec.address.bytes, ETH_ADDRESS_SIZE) == 0;
+}
+
+static const char * secret_name(result_kind kind)
+{
+    switch (kind) {
+    case RESULT_SPLITKEY_OFFSET: return "offset";
+    case RESULT_CREATE2_SALT: return "salt";
+    default: return "private_key";
+    }
+}
+
+std::string result_format_record(const result_sink_options &opt, const result_record &rec)
+{
+    std::string secret;
+    if (opt.kind == RESULT_CREATE2_SALT) {
+        unsigned char salt[32];
+        create2_salt(salt, opt.job, rec.counter);
+        secret = "0x" + to_hex(salt, 32);
+    } else {
+        secret = scalar_to_hex(rec.key);
+    }
+
+    std::string address = eth_address_to_string(rec.address);
+    if (opt.format == RESULT_CSV) {
+        return address + "," + secret;
+    }
+    return "{\"address\":\"" + address + "\",\"" + secret_name(opt.kind) + "\":\"" + secret + "\"}";
+}
+
+static void flush_buffer(result_sink &sink, bool sync)
+{
+    size_t off = 0;
+    while (off < sink.buffer.size()) {
+        ssize_t n = write(sink.fd, sink.buffer.data() + off, sink.buffer.size() - off);
+        if (n <= 0) {
+            std::cerr << "results: write failed, " << sink.buffer.size() - off << " bytes lost" << std::endl;
+            break;
+        }
+        off += n;
+    }
+    sink.buffer.clear();
+    if (sync && sink.fd != STDOUT_FILENO) {
+        fsync(sink.fd);
+        sink.unsynced = 0;
+    }
+}
+
+static void write_record(result_sink &sink, const result_record &rec)
+{
+    if (sink.full) {
+        return;
+    }
+    if (!result_verify(sink.opt, rec)) {
+        sink.rejected++;
+        std::cerr << "results: dropped a hit that does not verify" << std::endl;
+        return;
+    }
+    sink.buffer += result_format_record(sink.opt, rec);
+    sink.buffer += '\n';
+    sink.written++;
+    sink.unsynced++;
+    if (sink.opt.limit && sink.written >= sink.opt.limit) {
+        sink.full = true;
+    }
+
+    bool sync = sink.opt.fsync_every && sink.unsynced >= sink.opt.fsync_every;
+    if (sync || sink.buffer.size() >= RESULT_BUFFER_SIZE) {
+        flush_buffer(sink, sync);
+    }
+}
+
+static bool drain_rings(result_sink &sink)
+{
+    bool any = false;
+    for(int i = 0; i < sink.nworkers; i++)
+    {
+        result_ring &r = sink.rings[i];
+        uint64_t t = r.tail.load(std::memory_order_relaxed);
+        uint64_t h = r.head.load(std::memory_order_acquire);
+        for(; t < h; t++)
+        {
+            write_record(sink, r.records[t % RESULT_RING_SIZE]);
+            any = true;
+        }
+        r.tail.store(t, std::memory_order_release);
+    }
+    return any;
+}
+
+static void writer_loop(result_sink &sink)
+{
+    while (!sink.stop) {
+        if (!drain_rings(sink)) {
+            // nothing queued, get what we have to the file before idling
+            if (!sink.buffer.empty()) {
+                flush_buffer(sink, false);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void result_sink_open(result_sink &sink, const result_sink_options &opt, int nworkers)
+{
+    sink.opt = opt;
+    sink.nworkers = nworkers;
+    sink.rings.reset(new result_ring[nworkers]);
+    sink.full = false;
+    sink.written = 0;
+    sink.rejected = 0;
+    sink.unsynced = 0;
+    sink.dropped = 0;
+    sink.buffer.reserve(RESULT_BUFFER_SIZE);
+
+    // results are appended, a rerun must not clobber keys found earlier
+    if (opt.path == "-" || opt.path.empty()) {
+        sink.fd = STDOUT_FILENO;
+    } else {
+        sink.fd = open(opt.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (sink.fd < 0) {
+            throw new std::runtime_error("Could not open result file " + opt.path);
+        }
+    }
+    struct stat st;
+    if (opt.format == RESULT_CSV && (fstat(sink.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)) {
+        sink.buffer += std::string("address,") + secret_name(opt.kind) + "\n";
+    }
+
+    sink.stop = false;
+    sink.thread = std::thread(writer_loop, std::ref(sink));
+}
+
+bool result_sink_push(result_sink &sink, int worker, const result_record &rec)
+{
+    result_ring &r = sink.rings[worker];
+    uint64_t h = r.head.load(std::memory_order_relaxed);
+    if (h - r.tail.load(std::memory_order_acquire) >= RESULT_RING_SIZE) {
+        r.dropped++;
+    } else {
+        r.records[h % RESULT_RING_SIZE] = rec;
+        r.head.store(h + 1, std::memory_order_release);
+    }
+    return result_sink_full(sink);
+}
+
+void result_sink_close(result_sink &sink)
+{
+    if (!sink.thread.joinable()) {
+        return;
+    }
+    sink.stop = true;
+    sink.thread.join();
+
+    drain_rings(sink);
+    flush_buffer(sink, true);
+    for(int i = 0; i < sink.nworkers; i++)
+    {
+        sink.dropped += sink.rings[i].dropped;
+    }
+    if (sink.dropped) {
+        std::cerr << "results: " << sink.dropped << " hits dropped, the writer could not keep up" << std::endl;
+    }
+    if (sink.fd != STDOUT_FILENO) {
+        close(sink.fd);
+    }
+}
+
+result_sink::~result_sink()
+{
+    stop = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
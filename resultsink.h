@@ -0,0 +1,110 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include "secp256k1.h"
+#include "ethaddress.h"
+#include "create2.h"
+
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+// Hits are handed from the workers to a writer thread through one
+// single-producer ring per worker. Pushing a hit never waits on the writer or
+// on I/O and never allocates: a hit that finds its ring full is dropped and
+// counted, the count is reported when the sink is closed. The writer re-derives
+// every address from the reported secret on the generic (unbatched) path and
+// only writes hits that verify.
+
+enum result_kind
+{
+    // key is the private key
+    RESULT_ETH_KEY,
+    // key is the offset to add to the customer's secret
+    RESULT_SPLITKEY_OFFSET,
+    // counter is the create2 salt counter
+    RESULT_CREATE2_SALT
+};
+
+enum result_format
+{
+    RESULT_NDJSON,
+    RESULT_CSV
+};
+
+struct result_record
+{
+    secp256k1_scalar key;
+    uint64_t counter;
+    eth_address address;
+};
+
+struct result_sink_options
+{
+    // "-" for stdout
+    std::string path;
+    result_format format;
+    // fsync after this many records, 0 only at close
+    uint64_t fsync_every;
+    // verified hits to write before the search is asked to stop, 0 for no limit
+    uint64_t limit;
+    result_kind kind;
+    // verification context for splitkey and create2
+    secp256k1_point customer;
+    create2_job job;
+};
+
+const size_t RESULT_RING_SIZE = 1024;
+
+struct alignas(64) result_ring
+{
+    std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    result_record records[RESULT_RING_SIZE];
+    // hits that found the ring full, only touched by the worker until the
+    // search has ended
+    uint64_t dropped = 0;
+};
+
+struct result_sink
+{
+    result_sink_options opt;
+    int fd;
+    int nworkers;
+    std::unique_ptr<result_ring[]> rings;
+    // set by the writer once limit records are written, later hits are dropped
+    std::atomic<bool> full{false};
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    // writer thread state
+    std::string buffer;
+    uint64_t written;
+    uint64_t rejected;
+    uint64_t unsynced;
+    // summed over the rings at close
+    uint64_t dropped;
+
+    ~result_sink();
+};
+
+result_sink_options result_sink_default_options();
+
+void result_sink_open(result_sink &sink, const result_sink_options &opt, int nworkers);
+// true once the limit is reached, drops rec if the writer is a full ring behind
+bool result_sink_push(result_sink &sink, int worker, const result_record &rec);
+// polled by the workers between chunks, the writer may reach the limit
+// long after the last hit was pushed
+inline bool result_sink_full(const result_sink &sink)
+{
+    return sink.full.load(std::memory_order_relaxed);
+}
+// call after the workers have returned, writes what is left and syncs
+void result_sink_close(result_sink &sink);
+
+// the line for one verified record, without the newline
+std::string result_format_record(const result_sink_options &opt, const result_record &rec);
+bool result_verify(const result_sink_options &opt, const result_record &rec);
+
+#endif
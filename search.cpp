@@ -0,0 +1,37 @@
+#include "search.h"
+#include <thread>
+#include <vector>
+
+int search_default_threads()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Runs one worker per thread and returns when all of them have returned.
+// A worker that finds what it is looking for sets ctl.stop to end the others.
+void search_run(int nthreads, search_control &ctl, const search_worker &worker)
+{
+    if (nthreads < 1) {
+        nthreads = search_default_threads();
+    }
+
+    stats_reset(nthreads);
+    auto bound = [&](int i) {
+        stats_bind_thread(i);
+        worker(i, nthreads, ctl);
+        stats_current = nullptr;
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < nthreads; i++)
+    {
+        threads.emplace_back(bound, i);
+    }
+    bound(0);
+
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+}
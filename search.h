@@ -0,0 +1,29 @@
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "stats.h"
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// Shared state between the search driver and its workers.
+// Workers poll stop between batches and add their attempts in bulk through
+// search_count, which also feeds the per-thread stats counters.
+struct search_control
+{
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> attempts{0};
+};
+
+typedef std::function<void(int worker, int nworkers, search_control &ctl)> search_worker;
+
+static inline void search_count(search_control &ctl, uint64_t n)
+{
+    ctl.attempts += n;
+    stats_count_keys(n);
+}
+
+int search_default_threads();
+void search_run(int nthreads, search_control &ctl, const search_worker &worker);
+
+#endif
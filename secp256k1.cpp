@@ -1,13 +1,63 @@
 #include "secp256k1.h"
 #include "blockmath.h"
+#include "stats.h"
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
+#include <type_traits>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 using std::cout;
 using std::endl;
 
 // API functions
 
+template<typename Policy>
+static constexpr bool is_const_time = std::is_same<Policy, const_time>::value;
+
+// all ones when acc is zero, without a branch
+static inline uint32_t zero_mask(uint32_t acc)
+{
+    return ((acc | (0u - acc)) >> 31) - 1;
+}
+
+static inline uint32_t scalar_zero_mask(const secp256k1_scalar &a)
+{
+    uint32_t acc = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        acc |= a.d[i];
+    }
+    return zero_mask(acc);
+}
+
+// r = mask ? a : b for a mask of all ones or all zeros
+static inline void select_limbs(uint32_t * r, uint32_t mask, const uint32_t * a, const uint32_t * b, int n)
+{
+    for(int i = 0; i < n; i++)
+    {
+        r[i] = (a[i] & mask) | (b[i] & ~mask);
+    }
+}
+
+static inline secp256k1_scalar select_scalar(uint32_t mask, const secp256k1_scalar &a, const secp256k1_scalar &b)
+{
+    secp256k1_scalar r;
+    select_limbs(r.d, mask, a.d, b.d, 8);
+    return r;
+}
+
+static inline secp256k1_point_jacobian select_jacobian(uint32_t mask, const secp256k1_point_jacobian &a, const secp256k1_point_jacobian &b)
+{
+    secp256k1_point_jacobian r;
+    r.x = select_scalar(mask, a.x, b.x);
+    r.y = select_scalar(mask, a.y, b.y);
+    r.z = select_scalar(mask, a.z, b.z);
+    return r;
+}
+
 bool operator<(const secp256k1_scalar &a, const secp256k1_scalar &b)
 {
     return blockwise_cmp(a.d, b.d, sizeof(secp256k1_scalar)/sizeof(uint32_t)) == -1;
@@ -123,11 +173,25 @@ int lzcount(const secp256k1_mult_result &a)
 }
 
 
+template<typename Policy>
 secp256k1_mult_result mult(const secp256k1_scalar &a, const secp256k1_scalar &b)
 {
     secp256k1_mult_result res = secp256k1_mult_result();
 
-    blockwise_mult(res.d, a.d, b.d, sizeof(secp256k1_scalar)/sizeof(uint32_t));
+    // product scanning for both policies: every column sums all of its
+    // partial products in a 128-bit accumulator, which is branch free and
+    // faster than blockwise_mult's carry propagation
+    unsigned __int128 acc = 0;
+    for(int k = 0; k < 15; k++)
+    {
+        for(int i = k < 8 ? 0 : k - 7; i <= (k < 8 ? k : 7); i++)
+        {
+            acc += (uint64_t)a.d[7 - i] * b.d[7 - (k - i)];
+        }
+        res.d[15 - k] = (uint32_t)acc;
+        acc >>= 32;
+    }
+    res.d[0] = (uint32_t)acc;
 
     return res;
 }
@@ -156,8 +220,42 @@ secp256k1_scalar shrinkto256(const secp256k1_mult_result &a)
     return res;
 }
 
+// Restoring binary division: one shift, trial subtraction and select per bit
+// of a, the remainder gets a 17th limb for the bit shifted out of the top.
+static secp256k1_mult_result mod_const_time(const secp256k1_mult_result &a, const secp256k1_mult_result &m)
+{
+    uint32_t r[17] = {0};
+    uint32_t t[17];
+    for(int bit = 0; bit < 512; bit++)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            r[i] = (r[i] << 1) | (r[i + 1] >> 31);
+        }
+        r[16] = (r[16] << 1) | ((a.d[bit / 32] >> (31 - bit % 32)) & 1);
+
+        uint64_t borrow = 0;
+        for(int i = 16; i >= 0; i--)
+        {
+            uint64_t acc = (uint64_t)r[i] - (i > 0 ? m.d[i - 1] : 0) - borrow;
+            t[i] = (uint32_t)acc;
+            borrow = (acc >> 32) & 1;
+        }
+        select_limbs(r, (uint32_t)borrow - 1, t, r, 17);
+    }
+
+    secp256k1_mult_result res;
+    memcpy(res.d, r + 1, sizeof(res.d));
+    return res;
+}
+
+template<typename Policy>
 secp256k1_mult_result mod(const secp256k1_mult_result &a, const secp256k1_mult_result &m)
 {
+    if constexpr (is_const_time<Policy>) {
+        return mod_const_time(a, m);
+    }
+
     secp256k1_mult_result mod = m;
     secp256k1_mult_result last_mod = mod;
     secp256k1_mult_result tmp = a;
@@ -189,6 +287,10 @@ secp256k1_mult_result mod(const secp256k1_mult_result &a, const secp256k1_mult_r
             // potential risk here is that if -diff = 512, then this is a shift of 513 bits (which is illegal)
             // could only happen if mod is 0
             last_mod >>= (-diff + 1);
+            // shifted past mod it is no multiple of mod any more (and 0 for mod = 1)
+            if (last_mod < mod) {
+                last_mod = mod;
+            }
 
             tmp -= last_mod;
 
@@ -209,9 +311,15 @@ secp256k1_mult_result mod(const secp256k1_mult_result &a, const secp256k1_mult_r
     return tmp;
 }
 
-// This is not a fast solution
+// This is not a fast solution. The constant time version is the fold of fastreduce,
+// a division loop without the early exits would be slower still.
+template<typename Policy>
 secp256k1_scalar reduce(const secp256k1_mult_result &a)
 {
+    if constexpr (is_const_time<Policy>) {
+        return fastreduce<const_time>(a);
+    }
+
     secp256k1_mult_result mod = padto512(SECP256K1_P);
     secp256k1_mult_result last_mod = mod;
     secp256k1_mult_result tmp = a;
@@ -241,6 +349,9 @@ secp256k1_scalar reduce(const secp256k1_mult_result &a)
         } else if (diff < 0) {
             // make last_mod smaller, and never too small
             last_mod >>= (-diff + 1);
+            if (last_mod < mod) {
+                last_mod = mod;
+            }
 
             tmp -= last_mod;
 
@@ -261,45 +372,748 @@ secp256k1_scalar reduce(const secp256k1_mult_result &a)
     return shrinkto256(tmp);
 }
 
-// TODO
+// p = 2^256 - c with c = 2^32 + 977
+static const uint64_t SECP256K1_C_LOW = 977;
+
+// 256-bit helpers on big-endian limbs, return the carry/borrow out of the top limb
+static uint32_t add256(uint32_t * r, const uint32_t * a, const uint32_t * b)
+{
+    uint64_t carry = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        uint64_t acc = (uint64_t)a[i] + b[i] + carry;
+        r[i] = (uint32_t)acc;
+        carry = acc >> 32;
+    }
+    return carry;
+}
+
+static uint32_t sub256(uint32_t * r, const uint32_t * a, const uint32_t * b)
+{
+    uint64_t borrow = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        uint64_t acc = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)acc;
+        borrow = (acc >> 32) & 1;
+    }
+    return borrow;
+}
+
+static void shr1(uint32_t * a, uint32_t topbit)
+{
+    for(int i = 7; i > 0; i--)
+    {
+        a[i] = (a[i] >> 1) | (a[i-1] << 31);
+    }
+    a[0] = (a[0] >> 1) | (topbit << 31);
+}
+
+static bool is_zero(const secp256k1_scalar &a)
+{
+    uint32_t acc = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        acc |= a.d[i];
+    }
+    return acc == 0;
+}
+
+template<typename Policy>
+static secp256k1_scalar add_mod(const secp256k1_scalar &a, const secp256k1_scalar &b, const secp256k1_scalar &m)
+{
+    secp256k1_scalar res;
+    uint32_t carry = add256(res.d, a.d, b.d);
+    if constexpr (is_const_time<Policy>) {
+        // keep res - m unless that borrows without the carry out of res
+        secp256k1_scalar t;
+        uint32_t borrow = sub256(t.d, res.d, m.d);
+        return select_scalar(0u - (carry | (borrow ^ 1)), t, res);
+    }
+    if (carry || res >= m) {
+        sub256(res.d, res.d, m.d);
+    }
+    return res;
+}
+
+template<typename Policy>
+static secp256k1_scalar sub_mod(const secp256k1_scalar &a, const secp256k1_scalar &b, const secp256k1_scalar &m)
+{
+    secp256k1_scalar res;
+    uint32_t borrow = sub256(res.d, a.d, b.d);
+    if constexpr (is_const_time<Policy>) {
+        secp256k1_scalar masked;
+        select_limbs(masked.d, 0u - borrow, m.d, secp256k1_scalar().d, 8);
+        add256(res.d, res.d, masked.d);
+        return res;
+    }
+    if (borrow) {
+        add256(res.d, res.d, m.d);
+    }
+    return res;
+}
+
+template<typename Policy>
 secp256k1_scalar fastreduce(const secp256k1_mult_result &a)
 {
     /*
-        Use math: a * 2^n + b === ac + b (mod 2^n - c)
-        Probably: divide number into two parts, at least one has to be 512 bit
+        Use math: a * 2^256 + b === ac + b (mod 2^256 - c)
+        The high half times c is at most 289 bits, so the fold is done twice.
     */
+    const uint32_t * hi = a.d;
+    const uint32_t * lo = a.d + 8;
 
-    // Idea: split number into two halves...
-    return secp256k1_scalar();
+    // first fold: t = lo + hi * 977 + (hi << 32), 288 bits + a small top word
+    uint32_t t[8];
+    uint64_t carry = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        uint64_t acc = carry + lo[i] + hi[i] * SECP256K1_C_LOW;
+        if (i < 7) {
+            acc += hi[i+1];
+        }
+        t[i] = (uint32_t)acc;
+        carry = acc >> 32;
+    }
+    uint64_t top = carry + hi[0];
+
+    // second fold: top * c
+    secp256k1_scalar res;
+    carry = top * SECP256K1_C_LOW;
+    for(int i = 7; i >= 0; i--)
+    {
+        uint64_t acc = carry + t[i];
+        if (i == 6) {
+            acc += top;
+        }
+        res.d[i] = (uint32_t)acc;
+        carry = acc >> 32;
+    }
+
+    // the value wrapped past 2^256, what is left is tiny so adding c cannot overflow again
+    if constexpr (is_const_time<Policy>) {
+        // the carry is 0 or 1, add carry * c and propagate through every limb
+        uint64_t acc = (uint64_t)res.d[7] + carry * SECP256K1_C_LOW;
+        res.d[7] = (uint32_t)acc;
+        acc = (uint64_t)res.d[6] + carry + (acc >> 32);
+        res.d[6] = (uint32_t)acc;
+        for(int i = 5; i >= 0; i--)
+        {
+            acc = (uint64_t)res.d[i] + (acc >> 32);
+            res.d[i] = (uint32_t)acc;
+        }
+
+        secp256k1_scalar t;
+        uint32_t borrow = sub256(t.d, res.d, SECP256K1_P.d);
+        return select_scalar(borrow - 1, t, res);
+    }
+    if (carry) {
+        uint64_t acc = (uint64_t)res.d[7] + SECP256K1_C_LOW;
+        res.d[7] = (uint32_t)acc;
+        acc = (uint64_t)res.d[6] + 1 + (acc >> 32);
+        res.d[6] = (uint32_t)acc;
+        for(int i = 5; i >= 0 && (acc >> 32); i--)
+        {
+            acc = (uint64_t)res.d[i] + 1;
+            res.d[i] = (uint32_t)acc;
+        }
+    }
+
+    if (res >= SECP256K1_P) {
+        sub256(res.d, res.d, SECP256K1_P.d);
+    }
+    return res;
 }
 
-// TODO
+template<typename Policy>
 secp256k1_scalar modinv(const secp256k1_mult_result &a)
 {
+    if constexpr (is_const_time<Policy>) {
+        return field_inv<const_time>(fastreduce<const_time>(a));
+    }
+    return ext_euclidian(padto512(fastreduce(a)));
+}
 
-    return secp256k1_scalar();
+// Binary extended Euclidean algorithm, only the coefficient of a is tracked.
+// Not constant time.
+secp256k1_scalar ext_euclidian(const secp256k1_mult_result &a)
+{
+    secp256k1_scalar u = fastreduce(a);
+    secp256k1_scalar v = SECP256K1_P;
+    secp256k1_scalar x1 = secp256k1_scalar();
+    secp256k1_scalar x2 = secp256k1_scalar();
+    x1.d[7] = 1;
+
+    if (is_zero(u)) {
+        throw new std::runtime_error("Zero has no inverse");
+    }
+
+    secp256k1_scalar one = x1;
+    while (!(u == one) && !(v == one)) {
+        while ((u.d[7] & 1) == 0) {
+            shr1(u.d, 0);
+            uint32_t carry = 0;
+            if (x1.d[7] & 1) {
+                carry = add256(x1.d, x1.d, SECP256K1_P.d);
+            }
+            shr1(x1.d, carry);
+        }
+        while ((v.d[7] & 1) == 0) {
+            shr1(v.d, 0);
+            uint32_t carry = 0;
+            if (x2.d[7] & 1) {
+                carry = add256(x2.d, x2.d, SECP256K1_P.d);
+            }
+            shr1(x2.d, carry);
+        }
+
+        if (u >= v) {
+            sub256(u.d, u.d, v.d);
+            x1 = field_sub(x1, x2);
+        } else {
+            sub256(v.d, v.d, u.d);
+            x2 = field_sub(x2, x1);
+        }
+    }
+    return u == one ? x1 : x2;
 }
 
-// TODO
-secp256k1_point point_add()
+// p - 2, the Fermat exponent for inversion
+static const secp256k1_scalar SECP256K1_P_MINUS_2 = {
+    0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFF,
+    0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFE,0xFFFFFC2D
+};
+
+template<typename Policy>
+secp256k1_scalar field_add(const secp256k1_scalar &a, const secp256k1_scalar &b)
 {
-    return secp256k1_point();
+    return add_mod<Policy>(a, b, SECP256K1_P);
 }
 
-// TODO
-secp256k1_point point_doubling()
+template<typename Policy>
+secp256k1_scalar field_sub(const secp256k1_scalar &a, const secp256k1_scalar &b)
 {
-    return secp256k1_point();
+    return sub_mod<Policy>(a, b, SECP256K1_P);
 }
 
-// TODO
-secp256k1_point double_and_add()
+template<typename Policy>
+secp256k1_scalar field_neg(const secp256k1_scalar &a)
 {
-    return secp256k1_point();
+    return sub_mod<Policy>(secp256k1_scalar(), a, SECP256K1_P);
 }
 
-// TODO
-secp256k1_scalar ext_euclidian(const secp256k1_mult_result &a)
+template<typename Policy>
+secp256k1_scalar field_mul(const secp256k1_scalar &a, const secp256k1_scalar &b)
+{
+    return fastreduce<Policy>(mult<Policy>(a, b));
+}
+
+template<typename Policy>
+secp256k1_scalar field_sqr(const secp256k1_scalar &a)
+{
+    return fastreduce<Policy>(mult<Policy>(a, a));
+}
+
+template<typename Policy>
+secp256k1_scalar field_inv(const secp256k1_scalar &a)
 {
-    return secp256k1_scalar();
+    if constexpr (is_const_time<Policy>) {
+        return field_pow<const_time>(a, SECP256K1_P_MINUS_2);
+    }
+    return ext_euclidian(padto512(a));
 }
+
+// square and multiply, most significant bit first. The constant time version
+// always multiplies and selects the product by the exponent bit.
+template<typename Policy>
+secp256k1_scalar field_pow(const secp256k1_scalar &a, const secp256k1_scalar &e)
+{
+    secp256k1_scalar res = secp256k1_scalar();
+    res.d[7] = 1;
+    for(int i = 0; i < 256; i++)
+    {
+        res = field_sqr<Policy>(res);
+        uint32_t bit = (e.d[i / 32] >> (31 - i % 32)) & 1;
+        if constexpr (is_const_time<Policy>) {
+            res = select_scalar(0u - bit, field_mul<const_time>(res, a), res);
+        } else if (bit) {
+            res = field_mul(res, a);
+        }
+    }
+    return res;
+}
+
+bool field_sqrt(secp256k1_scalar &r, const secp256k1_scalar &a)
+{
+    r = field_pow(a, SECP256K1_SQRT_EXP);
+    return field_sqr(r) == a;
+}
+
+// Montgomery's trick: n inversions for the price of one and 3(n-1) multiplications.
+// scratch must hold n elements, none of the inputs may be zero.
+template<typename Policy>
+void field_batch_inv(secp256k1_scalar * a, size_t n, secp256k1_scalar * scratch)
+{
+    if (n == 0) {
+        return;
+    }
+
+    scratch[0] = a[0];
+    for(size_t i = 1; i < n; i++)
+    {
+        scratch[i] = field_mul<Policy>(scratch[i-1], a[i]);
+    }
+
+    secp256k1_scalar inv = field_inv<Policy>(scratch[n-1]);
+    for(size_t i = n - 1; i > 0; i--)
+    {
+        secp256k1_scalar ai_inv = field_mul<Policy>(inv, scratch[i-1]);
+        inv = field_mul<Policy>(inv, a[i]);
+        a[i] = ai_inv;
+    }
+    a[0] = inv;
+}
+
+template<typename Policy>
+secp256k1_scalar scalar_add(const secp256k1_scalar &a, const secp256k1_scalar &b)
+{
+    return add_mod<Policy>(a, b, SECP256K1_ORDER);
+}
+
+template<typename Policy>
+secp256k1_scalar scalar_cond_neg(const secp256k1_scalar &a, uint32_t flag)
+{
+    if constexpr (is_const_time<Policy>) {
+        return select_scalar(0u - flag, sub_mod<const_time>(secp256k1_scalar(), a, SECP256K1_ORDER), a);
+    }
+    return flag ? sub_mod<var_time>(secp256k1_scalar(), a, SECP256K1_ORDER) : a;
+}
+
+secp256k1_scalar scalar_from_uint64(uint64_t v)
+{
+    secp256k1_scalar res = secp256k1_scalar();
+    res.d[6] = v >> 32;
+    res.d[7] = (uint32_t)v;
+    return res;
+}
+
+bool point_is_infinity(const secp256k1_point &a)
+{
+    return is_zero(a.x) && is_zero(a.y);
+}
+
+// y^2 = x^3 + 7
+static secp256k1_scalar curve_rhs(const secp256k1_scalar &x)
+{
+    secp256k1_scalar seven = scalar_from_uint64(7);
+    return field_add(field_mul(field_sqr(x), x), seven);
+}
+
+bool point_is_on_curve(const secp256k1_point &a)
+{
+    if (point_is_infinity(a)) {
+        return true;
+    }
+    return field_sqr(a.y) == curve_rhs(a.x);
+}
+
+bool point_decompress(secp256k1_point &r, const secp256k1_key_compressed &key)
+{
+    if (key.bytes[0] != 0x02 && key.bytes[0] != 0x03) {
+        return false;
+    }
+
+    for(int i = 0; i < 8; i++)
+    {
+        const unsigned char * b = key.bytes + 1 + 4*i;
+        r.x.d[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    }
+    if (r.x >= SECP256K1_P) {
+        return false;
+    }
+
+    if (!field_sqrt(r.y, curve_rhs(r.x))) {
+        return false;
+    }
+    if ((r.y.d[7] & 1) != (key.bytes[0] & 1)) {
+        r.y = field_neg(r.y);
+    }
+    return true;
+}
+
+// infinity maps to z = 0 without a branch
+static inline secp256k1_point_jacobian jacobian_from_affine_const_time(const secp256k1_point &a)
+{
+    secp256k1_point_jacobian res;
+    res.x = a.x;
+    res.y = a.y;
+    res.z = secp256k1_scalar();
+    res.z.d[7] = 1 & ~(scalar_zero_mask(a.x) & scalar_zero_mask(a.y));
+    return res;
+}
+
+template<typename Policy>
+secp256k1_point point_add(const secp256k1_point &a, const secp256k1_point &b)
+{
+    if constexpr (is_const_time<Policy>) {
+        return jacobian_to_affine<const_time>(jacobian_add_affine<const_time>(jacobian_from_affine_const_time(a), b));
+    }
+
+    if (point_is_infinity(a)) return b;
+    if (point_is_infinity(b)) return a;
+
+    if (a.x == b.x) {
+        if (a.y == b.y) {
+            return point_doubling(a);
+        }
+        return SECP256K1_INFINITY;
+    }
+
+    secp256k1_scalar lambda = field_mul(field_sub(b.y, a.y), field_inv(field_sub(b.x, a.x)));
+
+    secp256k1_point res;
+    res.x = field_sub(field_sub(field_sqr(lambda), a.x), b.x);
+    res.y = field_sub(field_mul(lambda, field_sub(a.x, res.x)), a.y);
+    return res;
+}
+
+template<typename Policy>
+secp256k1_point point_doubling(const secp256k1_point &a)
+{
+    if constexpr (is_const_time<Policy>) {
+        return jacobian_to_affine<const_time>(jacobian_double<const_time>(jacobian_from_affine_const_time(a)));
+    }
+
+    if (point_is_infinity(a) || is_zero(a.y)) {
+        return SECP256K1_INFINITY;
+    }
+
+    secp256k1_scalar x2 = field_sqr(a.x);
+    secp256k1_scalar num = field_add(field_add(x2, x2), x2);
+    secp256k1_scalar lambda = field_mul(num, field_inv(field_add(a.y, a.y)));
+
+    secp256k1_point res;
+    res.x = field_sub(field_sqr(lambda), field_add(a.x, a.x));
+    res.y = field_sub(field_mul(lambda, field_sub(a.x, res.x)), a.y);
+    return res;
+}
+
+// The var_time version only adds for set bits. The const_time one adds for
+// every bit and keeps the sum by mask, which is a Montgomery ladder's cost
+// without its register swaps.
+template<typename Policy>
+secp256k1_point double_and_add(const secp256k1_scalar &k, const secp256k1_point &a)
+{
+    secp256k1_point_jacobian acc = secp256k1_point_jacobian();
+    for(int i = 0; i < 256; i++)
+    {
+        acc = jacobian_double<Policy>(acc);
+        uint32_t bit = (k.d[i / 32] >> (31 - i % 32)) & 1;
+        if constexpr (is_const_time<Policy>) {
+            acc = select_jacobian(0u - bit, jacobian_add_affine<const_time>(acc, a), acc);
+        } else if (bit) {
+            acc = jacobian_add_affine(acc, a);
+        }
+    }
+    return jacobian_to_affine<Policy>(acc);
+}
+
+secp256k1_point_jacobian jacobian_from_affine(const secp256k1_point &a)
+{
+    secp256k1_point_jacobian res = secp256k1_point_jacobian();
+    if (!point_is_infinity(a)) {
+        res.x = a.x;
+        res.y = a.y;
+        res.z.d[7] = 1;
+    }
+    return res;
+}
+
+// with const_time a zero z inverts to zero, which gives the affine infinity (0, 0)
+template<typename Policy>
+secp256k1_point jacobian_to_affine(const secp256k1_point_jacobian &a)
+{
+    if constexpr (!is_const_time<Policy>) {
+        if (is_zero(a.z)) {
+            return SECP256K1_INFINITY;
+        }
+    }
+    secp256k1_scalar zinv = field_inv<Policy>(a.z);
+    secp256k1_scalar zinv2 = field_sqr<Policy>(zinv);
+
+    secp256k1_point res;
+    res.x = field_mul<Policy>(a.x, zinv2);
+    res.y = field_mul<Policy>(a.y, field_mul<Policy>(zinv2, zinv));
+    return res;
+}
+
+// infinity and y = 0 both give z = 2yz = 0, the early exit only saves time
+template<typename Policy>
+secp256k1_point_jacobian jacobian_double(const secp256k1_point_jacobian &a)
+{
+    if constexpr (!is_const_time<Policy>) {
+        if (is_zero(a.z) || is_zero(a.y)) {
+            return secp256k1_point_jacobian();
+        }
+    }
+
+    // dbl-2009-l
+    secp256k1_scalar A = field_sqr<Policy>(a.x);
+    secp256k1_scalar B = field_sqr<Policy>(a.y);
+    secp256k1_scalar C = field_sqr<Policy>(B);
+    secp256k1_scalar D = field_sub<Policy>(field_sub<Policy>(field_sqr<Policy>(field_add<Policy>(a.x, B)), A), C);
+    D = field_add<Policy>(D, D);
+    secp256k1_scalar E = field_add<Policy>(field_add<Policy>(A, A), A);
+    secp256k1_scalar F = field_sqr<Policy>(E);
+
+    secp256k1_scalar C8 = field_add<Policy>(C, C);
+    C8 = field_add<Policy>(C8, C8);
+    C8 = field_add<Policy>(C8, C8);
+
+    secp256k1_point_jacobian res;
+    res.x = field_sub<Policy>(F, field_add<Policy>(D, D));
+    res.y = field_sub<Policy>(field_mul<Policy>(E, field_sub<Policy>(D, res.x)), C8);
+    res.z = field_mul<Policy>(a.y, a.z);
+    res.z = field_add<Policy>(res.z, res.z);
+    return res;
+}
+
+// For const_time the general formula always runs; a doubling (h = r = 0) and
+// an infinite input are selected in afterwards. h = 0 with r != 0 already gives z = 0.
+template<typename Policy>
+secp256k1_point_jacobian jacobian_add_affine(const secp256k1_point_jacobian &a, const secp256k1_point &b)
+{
+    if constexpr (!is_const_time<Policy>) {
+        if (point_is_infinity(b)) return a;
+        if (is_zero(a.z)) return jacobian_from_affine(b);
+    }
+
+    secp256k1_scalar z2 = field_sqr<Policy>(a.z);
+    secp256k1_scalar u2 = field_mul<Policy>(b.x, z2);
+    secp256k1_scalar s2 = field_mul<Policy>(b.y, field_mul<Policy>(z2, a.z));
+    secp256k1_scalar h = field_sub<Policy>(u2, a.x);
+    secp256k1_scalar r = field_sub<Policy>(s2, a.y);
+
+    if constexpr (!is_const_time<Policy>) {
+        if (is_zero(h)) {
+            if (is_zero(r)) {
+                return jacobian_double(a);
+            }
+            return secp256k1_point_jacobian();
+        }
+    }
+
+    secp256k1_scalar h2 = field_sqr<Policy>(h);
+    secp256k1_scalar h3 = field_mul<Policy>(h2, h);
+    secp256k1_scalar v = field_mul<Policy>(a.x, h2);
+
+    secp256k1_point_jacobian res;
+    res.x = field_sub<Policy>(field_sub<Policy>(field_sqr<Policy>(r), h3), field_add<Policy>(v, v));
+    res.y = field_sub<Policy>(field_mul<Policy>(r, field_sub<Policy>(v, res.x)), field_mul<Policy>(a.y, h3));
+    res.z = field_mul<Policy>(a.z, h);
+
+    if constexpr (is_const_time<Policy>) {
+        res = select_jacobian(scalar_zero_mask(h) & scalar_zero_mask(r), jacobian_double<const_time>(a), res);
+        res = select_jacobian(scalar_zero_mask(a.z), jacobian_from_affine_const_time(b), res);
+        res = select_jacobian(scalar_zero_mask(b.x) & scalar_zero_mask(b.y), a, res);
+    }
+    return res;
+}
+
+secp256k1_point_jacobian jacobian_add(const secp256k1_point_jacobian &a, const secp256k1_point_jacobian &b)
+{
+    if (is_zero(a.z)) return b;
+    if (is_zero(b.z)) return a;
+
+    secp256k1_scalar z1z1 = field_sqr(a.z);
+    secp256k1_scalar z2z2 = field_sqr(b.z);
+    secp256k1_scalar u1 = field_mul(a.x, z2z2);
+    secp256k1_scalar u2 = field_mul(b.x, z1z1);
+    secp256k1_scalar s1 = field_mul(a.y, field_mul(z2z2, b.z));
+    secp256k1_scalar s2 = field_mul(b.y, field_mul(z1z1, a.z));
+    secp256k1_scalar h = field_sub(u2, u1);
+    secp256k1_scalar r = field_sub(s2, s1);
+
+    if (is_zero(h)) {
+        if (is_zero(r)) {
+            return jacobian_double(a);
+        }
+        return secp256k1_point_jacobian();
+    }
+
+    secp256k1_scalar h2 = field_sqr(h);
+    secp256k1_scalar h3 = field_mul(h2, h);
+    secp256k1_scalar v = field_mul(u1, h2);
+
+    secp256k1_point_jacobian res;
+    res.x = field_sub(field_sub(field_sqr(r), h3), field_add(v, v));
+    res.y = field_sub(field_mul(r, field_sub(v, res.x)), field_mul(s1, h3));
+    res.z = field_mul(field_mul(a.z, b.z), h);
+    return res;
+}
+
+// scratch must hold 2n elements
+template<typename Policy>
+void jacobian_batch_to_affine(secp256k1_point * r, const secp256k1_point_jacobian * a, size_t n, secp256k1_scalar * scratch)
+{
+    secp256k1_scalar * zinv = scratch;
+    secp256k1_scalar one = scalar_from_uint64(1);
+    if constexpr (is_const_time<Policy>) {
+        for(size_t i = 0; i < n; i++)
+        {
+            zinv[i] = select_scalar(scalar_zero_mask(a[i].z), one, a[i].z);
+        }
+        field_batch_inv<const_time>(zinv, n, scratch + n);
+        for(size_t i = 0; i < n; i++)
+        {
+            uint32_t inf = scalar_zero_mask(a[i].z);
+            secp256k1_scalar zinv2 = field_sqr<const_time>(zinv[i]);
+            r[i].x = select_scalar(inf, secp256k1_scalar(), field_mul<const_time>(a[i].x, zinv2));
+            r[i].y = select_scalar(inf, secp256k1_scalar(),
+                field_mul<const_time>(a[i].y, field_mul<const_time>(zinv2, zinv[i])));
+        }
+        return;
+    }
+
+    for(size_t i = 0; i < n; i++)
+    {
+        // infinity is kept out of the product and mapped back below
+        zinv[i] = is_zero(a[i].z) ? one : a[i].z;
+    }
+    field_batch_inv(zinv, n, scratch + n);
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if (is_zero(a[i].z)) {
+            r[i] = SECP256K1_INFINITY;
+            continue;
+        }
+        secp256k1_scalar zinv2 = field_sqr(zinv[i]);
+        r[i].x = field_mul(a[i].x, zinv2);
+        r[i].y = field_mul(a[i].y, field_mul(zinv2, zinv[i]));
+    }
+}
+
+// Limbs are big-endian in order but native (little) endian within a limb,
+// so a field element becomes 32 big-endian bytes by swapping each 32-bit word.
+static inline void write_be256(unsigned char * out, const secp256k1_scalar &a)
+{
+#ifdef __SSSE3__
+    const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m128i lo = _mm_loadu_si128((const __m128i *)a.d);
+    __m128i hi = _mm_loadu_si128((const __m128i *)(a.d + 4));
+    _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(lo, swap));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_shuffle_epi8(hi, swap));
+#else
+    for(int i = 0; i < 8; i++)
+    {
+        uint32_t be = __builtin_bswap32(a.d[i]);
+        memcpy(out + 4*i, &be, sizeof(be));
+    }
+#endif
+}
+
+void serialize_compressed(secp256k1_key_compressed * r, const secp256k1_point * a, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        r[i].bytes[0] = 0x02 | (a[i].y.d[7] & 1);
+        write_be256(r[i].bytes + 1, a[i].x);
+    }
+}
+
+void serialize_uncompressed(secp256k1_key_uncompressed * r, const secp256k1_point * a, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        r[i].bytes[0] = 0x04;
+        write_be256(r[i].bytes + 1, a[i].x);
+        write_be256(r[i].bytes + 33, a[i].y);
+    }
+}
+
+// table[i] = (i + 1) * a
+void point_multiples(secp256k1_point * table, const secp256k1_point &a, size_t n)
+{
+    secp256k1_point_jacobian * acc = new secp256k1_point_jacobian[n];
+    secp256k1_scalar * scratch = new secp256k1_scalar[2*n];
+
+    secp256k1_point_jacobian cur = jacobian_from_affine(a);
+    for(size_t i = 0; i < n; i++)
+    {
+        acc[i] = cur;
+        cur = jacobian_add_affine(cur, a);
+    }
+    jacobian_batch_to_affine(table, acc, n, scratch);
+
+    delete[] acc;
+    delete[] scratch;
+}
+
+// r[i] = base + table[i] with a single shared inversion.
+// Slots where the x coordinates collide (base = +-table[i], or either is infinity)
+// are left out of the batch and computed with the generic addition.
+// scratch must hold 2n elements.
+void point_add_batch(secp256k1_point * r, const secp256k1_point &base, const secp256k1_point * table, size_t n, secp256k1_scalar * scratch)
+{
+    secp256k1_scalar * dx = scratch;
+    secp256k1_scalar one = scalar_from_uint64(1);
+    bool base_inf = point_is_infinity(base);
+    bool special = false;
+    for(size_t i = 0; i < n; i++)
+    {
+        dx[i] = field_sub(table[i].x, base.x);
+        if (base_inf || is_zero(dx[i]) || point_is_infinity(table[i])) {
+            dx[i] = one;
+            special = true;
+        }
+    }
+    STATS_TIMER_START(t_inv);
+    field_batch_inv(dx, n, scratch + n);
+    STATS_TIMER_STOP(t_inv, STATS_STAGE_INVERSION);
+
+    for(size_t i = 0; i < n; i++)
+    {
+        secp256k1_scalar lambda = field_mul(field_sub(table[i].y, base.y), dx[i]);
+        r[i].x = field_sub(field_sub(field_sqr(lambda), base.x), table[i].x);
+        r[i].y = field_sub(field_mul(lambda, field_sub(base.x, r[i].x)), base.y);
+    }
+
+    if (special) {
+        for(size_t i = 0; i < n; i++)
+        {
+            if (base_inf || table[i].x == base.x || point_is_infinity(table[i])) {
+                r[i] = point_add(base, table[i]);
+            }
+        }
+    }
+}
+
+// Both policies are instantiated here so that the definitions stay out of the header.
+#define SECP256K1_INSTANTIATE(P) \
+    template secp256k1_mult_result mult<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar reduce<P>(const secp256k1_mult_result &); \
+    template secp256k1_mult_result mod<P>(const secp256k1_mult_result &, const secp256k1_mult_result &); \
+    template secp256k1_scalar fastreduce<P>(const secp256k1_mult_result &); \
+    template secp256k1_scalar modinv<P>(const secp256k1_mult_result &); \
+    template secp256k1_scalar field_add<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar field_sub<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar field_neg<P>(const secp256k1_scalar &); \
+    template secp256k1_scalar field_mul<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar field_sqr<P>(const secp256k1_scalar &); \
+    template secp256k1_scalar field_inv<P>(const secp256k1_scalar &); \
+    template secp256k1_scalar field_pow<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar scalar_add<P>(const secp256k1_scalar &, const secp256k1_scalar &); \
+    template secp256k1_scalar scalar_cond_neg<P>(const secp256k1_scalar &, uint32_t); \
+    template secp256k1_point point_add<P>(const secp256k1_point &, const secp256k1_point &); \
+    template secp256k1_point point_doubling<P>(const secp256k1_point &); \
+    template secp256k1_point double_and_add<P>(const secp256k1_scalar &, const secp256k1_point &); \
+    template secp256k1_point jacobian_to_affine<P>(const secp256k1_point_jacobian &); \
+    template secp256k1_point_jacobian jacobian_double<P>(const secp256k1_point_jacobian &); \
+    template secp256k1_point_jacobian jacobian_add_affine<P>(const secp256k1_point_jacobian &, const secp256k1_point &); \
+    template void field_batch_inv<P>(secp256k1_scalar *, size_t, secp256k1_scalar *); \
+    template void jacobian_batch_to_affine<P>(secp256k1_point *, const secp256k1_point_jacobian *, size_t, secp256k1_scalar *);
+
+SECP256K1_INSTANTIATE(var_time)
+SECP256K1_INSTANTIATE(const_time)
+#undef SECP256K1_INSTANTIATE
@@ -1,5 +1,7 @@
 #include <utility>
 #include <cstdint>
+#include <cstddef>
+#include <string>
 
 #ifndef SECP256K1_H
 #define SECP256K1_H
@@ -10,12 +12,21 @@ struct secp256k1_scalar
     uint32_t d[8];
 };
 
+// affine point, the point at infinity is represented by x = y = 0
 struct secp256k1_point
 {
     secp256k1_scalar x;
     secp256k1_scalar y;
 };
 
+// jacobian point (x/z^2, y/z^3), the point at infinity has z = 0
+struct secp256k1_point_jacobian
+{
+    secp256k1_scalar x;
+    secp256k1_scalar y;
+    secp256k1_scalar z;
+};
+
 struct secp256k1_mult_result
 {
     uint32_t d[16];
@@ -48,6 +59,14 @@ const secp256k1_scalar SECP256K1_ORDER = {
     0xBAAEDCE6,0xAF48A03B,0xBFD25E8C,0xD0364141
 };
 
+// (p + 1) / 4, square roots are a^((p + 1) / 4) since p = 3 mod 4
+const secp256k1_scalar SECP256K1_SQRT_EXP = {
+    0x3FFFFFFF,0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFF,
+    0xFFFFFFFF,0xFFFFFFFF,0xFFFFFFFF,0xBFFFFF0C
+};
+
+const secp256k1_point SECP256K1_INFINITY = {};
+
 bool operator<(const secp256k1_scalar &a, const secp256k1_scalar &b);
 bool operator<(const secp256k1_mult_result &a, const secp256k1_mult_result &b);
 
@@ -84,15 +103,114 @@ int lzcount(const secp256k1_mult_result &a);
 secp256k1_mult_result padto512(const secp256k1_scalar &a);
 secp256k1_scalar shrinkto256(const secp256k1_mult_result &a);
 
+// Arithmetic policies, chosen per call site at compile time.
+// var_time may branch, exit early and index tables on the values; it is the
+// default and meant for public data such as the walk P + iG and its normalisation.
+// const_time runs the same instructions and memory accesses for every input and
+// is for secrets: seed multiplication, key derivation, key reconstruction and
+// their inversions.
+struct var_time {};
+struct const_time {};
+
+template<typename Policy = var_time>
 secp256k1_mult_result mult(const secp256k1_scalar &a, const secp256k1_scalar &b);
+template<typename Policy = var_time>
 secp256k1_scalar reduce(const secp256k1_mult_result &a);
+// m must not be zero
+template<typename Policy = var_time>
 secp256k1_mult_result mod(const secp256k1_mult_result &a, const secp256k1_mult_result &m);
+template<typename Policy = var_time>
 secp256k1_scalar fastreduce(const secp256k1_mult_result &a);
 secp256k1_scalar ext_euclidian(const secp256k1_mult_result &a);
+// var_time uses the binary extended Euclidean algorithm, const_time Fermat (a^(p-2), zero maps to zero)
+template<typename Policy = var_time>
 secp256k1_scalar modinv(const secp256k1_mult_result &a);
 
-secp256k1_point point_add();
-secp256k1_point point_doubling();
-secp256k1_point double_and_add();
+// field arithmetic mod p, inputs are expected to be normalised (< p)
+template<typename Policy = var_time>
+secp256k1_scalar field_add(const secp256k1_scalar &a, const secp256k1_scalar &b);
+template<typename Policy = var_time>
+secp256k1_scalar field_sub(const secp256k1_scalar &a, const secp256k1_scalar &b);
+template<typename Policy = var_time>
+secp256k1_scalar field_neg(const secp256k1_scalar &a);
+template<typename Policy = var_time>
+secp256k1_scalar field_mul(const secp256k1_scalar &a, const secp256k1_scalar &b);
+template<typename Policy = var_time>
+secp256k1_scalar field_sqr(const secp256k1_scalar &a);
+template<typename Policy = var_time>
+secp256k1_scalar field_inv(const secp256k1_scalar &a);
+template<typename Policy = var_time>
+secp256k1_scalar field_pow(const secp256k1_scalar &a, const secp256k1_scalar &e);
+bool field_sqrt(secp256k1_scalar &r, const secp256k1_scalar &a);
+template<typename Policy = var_time>
+void field_batch_inv(secp256k1_scalar * a, size_t n, secp256k1_scalar * scratch);
+
+// scalar arithmetic mod the group order
+template<typename Policy = var_time>
+secp256k1_scalar scalar_add(const secp256k1_scalar &a, const secp256k1_scalar &b);
+// a for flag 0, -a for flag 1
+template<typename Policy = var_time>
+secp256k1_scalar scalar_cond_neg(const secp256k1_scalar &a, uint32_t flag);
+secp256k1_scalar scalar_from_uint64(uint64_t v);
+
+bool point_is_infinity(const secp256k1_point &a);
+bool point_is_on_curve(const secp256k1_point &a);
+bool point_decompress(secp256k1_point &r, const secp256k1_key_compressed &key);
+
+// the const_time point routines cover infinity and doubling by selecting between
+// results that are all computed, so they cost about one extra doubling per addition
+template<typename Policy = var_time>
+secp256k1_point point_add(const secp256k1_point &a, const secp256k1_point &b);
+template<typename Policy = var_time>
+secp256k1_point point_doubling(const secp256k1_point &a);
+template<typename Policy = var_time>
+secp256k1_point double_and_add(const secp256k1_scalar &k, const secp256k1_point &a);
+
+secp256k1_point_jacobian jacobian_from_affine(const secp256k1_point &a);
+template<typename Policy = var_time>
+secp256k1_point jacobian_to_affine(const secp256k1_point_jacobian &a);
+template<typename Policy = var_time>
+secp256k1_point_jacobian jacobian_double(const secp256k1_point_jacobian &a);
+template<typename Policy = var_time>
+secp256k1_point_jacobian jacobian_add_affine(const secp256k1_point_jacobian &a, const secp256k1_point &b);
+secp256k1_point_jacobian jacobian_add(const secp256k1_point_jacobian &a, const secp256k1_point_jacobian &b);
+template<typename Policy = var_time>
+void jacobian_batch_to_affine(secp256k1_point * r, const secp256k1_point_jacobian * a, size_t n, secp256k1_scalar * scratch);
+
+// Batched serialisation of normalised affine points.
+// Uncompressed keys are 0x04 || x || y, so bytes + 1 is the 64 byte Keccak input
+// for Ethereum addresses and keys can be hashed in place.
+void serialize_compressed(secp256k1_key_compressed * r, const secp256k1_point * a, size_t n);
+void serialize_uncompressed(secp256k1_key_uncompressed * r, const secp256k1_point * a, size_t n);
+
+// batched affine engine
+void point_multiples(secp256k1_point * table, const secp256k1_point &a, size_t n);
+void point_add_batch(secp256k1_point * r, const secp256k1_point &base, const secp256k1_point * table, size_t n, secp256k1_scalar * scratch);
+
+// Fixed-base multiplication with a table of j * 256^i * G (built on first use):
+// one mixed addition per key byte and no doublings. var_time indexes the table by
+// the key bytes and skips zero bytes; const_time reads every entry of a window and
+// keeps the one for the key byte by mask, then always adds.
+// Keys must be in [1, n), the batch functions throw otherwise.
+template<typename Policy = var_time>
+secp256k1_point generator_mult(const secp256k1_scalar &k);
+
+// r[i] = p[i] + t[i] * G with one shared inversion, for tweaked keys. t[i] may
+// be zero but must be below the group order; acc holds n and scratch 2n elements.
+// var_time, the tweaks are hashes of public keys.
+void generator_mult_add_batch(secp256k1_point * r, const secp256k1_point * p, const secp256k1_scalar * t, size_t n,
+    secp256k1_point_jacobian * acc, secp256k1_scalar * scratch);
+
+// Public keys for n private keys, on the const_time comb. The sums stay in Jacobian
+// coordinates and are normalised with one shared (const_time) inversion per chunk;
+// nthreads > 1 splits the keys over threads.
+void derive_pubkeys(secp256k1_point * r, const secp256k1_scalar * k, size_t n, int nthreads);
+void derive_pubkeys_compressed(secp256k1_key_compressed * r, const secp256k1_scalar * k, size_t n, int nthreads);
+void derive_pubkeys_uncompressed(secp256k1_key_uncompressed * r, const secp256k1_scalar * k, size_t n, int nthreads);
+
+// File to file: the input is a sequence of 32 byte big-endian private keys, the
+// output the matching 33 or 65 byte public keys. The input is mmapped and
+// processed in chunks so that files larger than memory work. Returns the key count.
+size_t derive_pubkeys_file(const std::string &in_path, const std::string &out_path, bool compressed, int nthreads);
 
 #endif
@@ -0,0 +1,256 @@
+#include "secp256k1.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+// Batch public key derivation, see secp256k1.h
+
+static const int COMB_WINDOWS = 32;
+static const int COMB_ENTRIES = 255;
+// keys per shared inversion
+static const size_t DERIVE_CHUNK = 1024;
+// keys per mmapped chunk in the file mode
+static const size_t DERIVE_FILE_CHUNK = 1 << 16;
+
+// comb[i * 255 + j - 1] = j * 256^i * G
+static const std::vector<secp256k1_point> &generator_comb()
+{
+    static const std::vector<secp256k1_point> comb = []() {
+        std::vector<secp256k1_point> t(COMB_WINDOWS * COMB_ENTRIES);
+        secp256k1_point base = SECP256K1_GENERATOR;
+        for(int i = 0; i < COMB_WINDOWS; i++)
+        {
+            secp256k1_point * w = t.data() + i * COMB_ENTRIES;
+            point_multiples(w, base, COMB_ENTRIES);
+            base = point_add(w[COMB_ENTRIES - 1], base);
+        }
+        return t;
+    }();
+    return comb;
+}
+
+static inline int key_byte(const secp256k1_scalar &k, int i)
+{
+    return (k.d[7 - i / 4] >> (8 * (i % 4))) & 0xFF;
+}
+
+// entry b of a window, or infinity for b = 0, read by scanning all entries so
+// that the addresses touched do not depend on b
+static secp256k1_point comb_entry_const_time(const secp256k1_point * w, uint32_t b)
+{
+    secp256k1_point e = SECP256K1_INFINITY;
+    for(uint32_t j = 1; j <= (uint32_t)COMB_ENTRIES; j++)
+    {
+        uint32_t x = j ^ b;
+        uint32_t mask = ((x | (0u - x)) >> 31) - 1;
+        for(int l = 0; l < 8; l++)
+        {
+            e.x.d[l] |= w[j - 1].x.d[l] & mask;
+            e.y.d[l] |= w[j - 1].y.d[l] & mask;
+        }
+    }
+    return e;
+}
+
+// no partial sum can equal or cancel the next table entry for k in [1, n),
+// so the mixed addition never hits its doubling or infinity case
+template<typename Policy>
+static secp256k1_point_jacobian comb_sum(const std::vector<secp256k1_point> &comb, const secp256k1_scalar &k)
+{
+    secp256k1_point_jacobian acc = secp256k1_point_jacobian();
+    for(int i = 0; i < COMB_WINDOWS; i++)
+    {
+        int b = key_byte(k, i);
+        if constexpr (std::is_same<Policy, const_time>::value) {
+            // a zero byte adds infinity, which jacobian_add_affine selects away
+            acc = jacobian_add_affine<const_time>(acc, comb_entry_const_time(comb.data() + i * COMB_ENTRIES, b));
+        } else if (b) {
+            acc = jacobian_add_affine(acc, comb[i * COMB_ENTRIES + b - 1]);
+        }
+    }
+    return acc;
+}
+
+// 1 if k is zero or not below the group order, 0 otherwise, without a branch
+// on the key: the borrow out of k - n is 1 exactly when k < n
+static uint32_t key_out_of_range(const secp256k1_scalar &k)
+{
+    uint64_t borrow = 0;
+    uint32_t any = 0;
+    for(int i = 7; i >= 0; i--)
+    {
+        uint64_t acc = (uint64_t)k.d[i] - SECP256K1_ORDER.d[i] - borrow;
+        borrow = (acc >> 32) & 1;
+        any |= k.d[i];
+    }
+    uint32_t zero = (uint32_t)(((uint64_t)any - 1) >> 63);
+    return (uint32_t)(borrow ^ 1) | zero;
+}
+
+template<typename Policy>
+secp256k1_point generator_mult(const secp256k1_scalar &k)
+{
+    return jacobian_to_affine<Policy>(comb_sum<Policy>(generator_comb(), k));
+}
+
+template secp256k1_point generator_mult<var_time>(const secp256k1_scalar &);
+template secp256k1_point generator_mult<const_time>(const secp256k1_scalar &);
+
+static void derive_range(secp256k1_point * r, const secp256k1_scalar * k, size_t n)
+{
+    const std::vector<secp256k1_point> &comb = generator_comb();
+    std::vector<secp256k1_point_jacobian> acc(DERIVE_CHUNK);
+    std::vector<secp256k1_scalar> scratch(2 * DERIVE_CHUNK);
+    for(size_t off = 0; off < n; off += DERIVE_CHUNK)
+    {
+        size_t m = std::min(DERIVE_CHUNK, n - off);
+        for(size_t i = 0; i < m; i++)
+        {
+            acc[i] = comb_sum<const_time>(comb, k[off + i]);
+        }
+        jacobian_batch_to_affine<const_time>(r + off, acc.data(), m, scratch.data());
+    }
+}
+
+void generator_mult_add_batch(secp256k1_point * r, const secp256k1_point * p, const secp256k1_scalar * t, size_t n,
+    secp256k1_point_jacobian * acc, secp256k1_scalar * scratch)
+{
+    const std::vector<secp256k1_point> &comb = generator_comb();
+    for(size_t i = 0; i < n; i++)
+    {
+        // the last addition is the general one, tG may equal or cancel p
+        acc[i] = jacobian_add_affine(comb_sum<var_time>(comb, t[i]), p[i]);
+    }
+    jacobian_batch_to_affine(r, acc, n, scratch);
+}
+
+void derive_pubkeys(secp256k1_point * r, const secp256k1_scalar * k, size_t n, int nthreads)
+{
+    // checked over the whole batch, a bad key is only reported at the end
+    uint32_t bad = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        bad |= key_out_of_range(k[i]);
+    }
+    if (bad) {
+        throw new std::runtime_error("Private key is zero or not below the group order");
+    }
+    // built here so the threads do not all wait on the first use
+    generator_comb();
+
+    size_t nt = std::max(1, std::min<int>(nthreads, (n + DERIVE_CHUNK - 1) / DERIVE_CHUNK));
+    size_t per = (n + nt - 1) / nt;
+    std::vector<std::thread> threads;
+    for(size_t t = 1; t < nt; t++)
+    {
+        size_t lo = std::min(n, t * per);
+        size_t hi = std::min(n, lo + per);
+        threads.emplace_back(derive_range, r + lo, k + lo, hi - lo);
+    }
+    derive_range(r, k, std::min(n, per));
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+}
+
+void derive_pubkeys_compressed(secp256k1_key_compressed * r, const secp256k1_scalar * k, size_t n, int nthreads)
+{
+    std::vector<secp256k1_point> pts(n);
+    derive_pubkeys(pts.data(), k, n, nthreads);
+    serialize_compressed(r, pts.data(), n);
+}
+
+void derive_pubkeys_uncompressed(secp256k1_key_uncompressed * r, const secp256k1_scalar * k, size_t n, int nthreads)
+{
+    std::vector<secp256k1_point> pts(n);
+    derive_pubkeys(pts.data(), k, n, nthreads);
+    serialize_uncompressed(r, pts.data(), n);
+}
+
+static void write_all(int fd, const unsigned char * data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            throw new std::runtime_error("Could not write the public key file");
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+size_t derive_pubkeys_file(const std::string &in_path, const std::string &out_path, bool compressed, int nthreads)
+{
+    int in = open(in_path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (in < 0 || fstat(in, &st) != 0) {
+        if (in >= 0) close(in);
+        throw new std::runtime_error("Could not open the private key file");
+    }
+    if (st.st_size % 32 != 0) {
+        close(in);
+        throw new std::runtime_error("Private key file is not a whole number of 32 byte keys");
+    }
+    size_t n = st.st_size / 32;
+
+    const unsigned char * keys = nullptr;
+    if (n > 0) {
+        void * m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+        if (m == MAP_FAILED) {
+            close(in);
+            throw new std::runtime_error("Could not map the private key file");
+        }
+        madvise(m, st.st_size, MADV_SEQUENTIAL);
+        keys = (const unsigned char *)m;
+    }
+    close(in);
+
+    int out = open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        if (keys) munmap((void *)keys, st.st_size);
+        throw new std::runtime_error("Could not create the public key file");
+    }
+
+    std::vector<secp256k1_scalar> k(std::min(n, DERIVE_FILE_CHUNK));
+    std::vector<secp256k1_point> pts(k.size());
+    std::vector<secp256k1_key_compressed> ck(compressed ? k.size() : 0);
+    std::vector<secp256k1_key_uncompressed> uk(compressed ? 0 : k.size());
+    try {
+        for(size_t off = 0; off < n; off += DERIVE_FILE_CHUNK)
+        {
+            size_t m = std::min(DERIVE_FILE_CHUNK, n - off);
+            const unsigned char * p = keys + 32 * off;
+            for(size_t i = 0; i < m; i++, p += 32)
+            {
+                for(int j = 0; j < 8; j++)
+                {
+                    k[i].d[j] = ((uint32_t)p[4*j] << 24) | ((uint32_t)p[4*j + 1] << 16) | ((uint32_t)p[4*j + 2] << 8) | p[4*j + 3];
+                }
+            }
+            derive_pubkeys(pts.data(), k.data(), m, nthreads);
+            if (compressed) {
+                serialize_compressed(ck.data(), pts.data(), m);
+                write_all(out, ck[0].bytes, m * sizeof(secp256k1_key_compressed));
+            } else {
+                serialize_uncompressed(uk.data(), pts.data(), m);
+                write_all(out, uk[0].bytes, m * sizeof(secp256k1_key_uncompressed));
+            }
+            // the chunk will not be read again
+            madvise((void *)((uintptr_t)(keys + 32 * off) & ~(uintptr_t)4095), 32 * m, MADV_DONTNEED);
+        }
+    } catch (...) {
+        close(out);
+        if (keys) munmap((void *)keys, st.st_size);
+        throw;
+    }
+    close(out);
+    if (keys) munmap((void *)keys, st.st_size);
+    return n;
+}
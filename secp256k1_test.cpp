@@ -8,8 +8,11 @@
 #include <iostream>
 #include "secp256k1.h"
 #include "testconstants.h"
+#include "aesctr.h"
 #include <random>
 #include <vector>
+#include <cstdio>
+#include <unistd.h>
 using std::abs;
 using std::size_t;
 
@@ -284,4 +287,513 @@ public:
     TS_ASSERT_EQUALS(reduced, ZERO);
   }
 
+  // FIELD AND POINT TESTS
+
+  static secp256k1_scalar random_field(std::mt19937 &rng)
+  {
+    secp256k1_scalar res;
+    for(int i = 0; i < 8; i++)
+    {
+      res.d[i] = rng();
+    }
+    return reduce(padto512(res));
+  }
+
+  static bool points_equal(const secp256k1_point &a, const secp256k1_point &b)
+  {
+    return a.x == b.x && a.y == b.y;
+  }
+
+  void testFastReduceMatchesReduce()
+  {
+    std::mt19937 rng(1);
+    for(int i = 0; i < 200; i++)
+    {
+      secp256k1_mult_result x;
+      for(int j = 0; j < 16; j++)
+      {
+        x.d[j] = rng();
+      }
+      TS_ASSERT_EQUALS(fastreduce(x), reduce(x));
+    }
+    TS_ASSERT_EQUALS(fastreduce(MAXpow2), reduce(MAXpow2));
+    TS_ASSERT_EQUALS(fastreduce(padto512(SECP256K1_P)), ZERO);
+    TS_ASSERT_EQUALS(fastreduce(padto512(MAX)), reduce(padto512(MAX)));
+  }
+
+  void testFieldInverse()
+  {
+    std::mt19937 rng(2);
+    for(int i = 0; i < 50; i++)
+    {
+      secp256k1_scalar a = random_field(rng);
+      TS_ASSERT_EQUALS(field_mul(a, field_inv(a)), ONE);
+    }
+    TS_ASSERT_EQUALS(field_inv(ONE), ONE);
+    TS_ASSERT_THROWS_ANYTHING(field_inv(ZERO));
+  }
+
+  void testFieldBatchInverse()
+  {
+    std::mt19937 rng(3);
+    std::vector<secp256k1_scalar> a(17), inv(17), scratch(17);
+    for(size_t i = 0; i < a.size(); i++)
+    {
+      a[i] = random_field(rng);
+      inv[i] = a[i];
+    }
+    field_batch_inv(inv.data(), inv.size(), scratch.data());
+    for(size_t i = 0; i < a.size(); i++)
+    {
+      TS_ASSERT_EQUALS(inv[i], field_inv(a[i]));
+    }
+  }
+
+  void testFieldSqrt()
+  {
+    std::mt19937 rng(4);
+    for(int i = 0; i < 20; i++)
+    {
+      secp256k1_scalar a = random_field(rng);
+      secp256k1_scalar r;
+      TS_ASSERT(field_sqrt(r, field_sqr(a)));
+      TS_ASSERT(r == a || r == field_neg(a));
+    }
+  }
+
+  void testGeneratorIsOnCurve()
+  {
+    TS_ASSERT(point_is_on_curve(SECP256K1_GENERATOR));
+    TS_ASSERT(point_is_on_curve(GENERATOR_TIMES_TWO));
+  }
+
+  void testPointDoubling()
+  {
+    TS_ASSERT(points_equal(point_doubling(SECP256K1_GENERATOR), GENERATOR_TIMES_TWO));
+    TS_ASSERT(points_equal(point_add(SECP256K1_GENERATOR, SECP256K1_GENERATOR), GENERATOR_TIMES_TWO));
+  }
+
+  void testPointAdd()
+  {
+    TS_ASSERT(points_equal(point_add(SECP256K1_GENERATOR, GENERATOR_TIMES_TWO), GENERATOR_TIMES_THREE));
+    TS_ASSERT(points_equal(point_add(SECP256K1_INFINITY, GENERATOR_TIMES_TWO), GENERATOR_TIMES_TWO));
+
+    secp256k1_point neg = {SECP256K1_GENERATOR.x, field_neg(SECP256K1_GENERATOR.y)};
+    TS_ASSERT(point_is_infinity(point_add(SECP256K1_GENERATOR, neg)));
+  }
+
+  void testDoubleAndAdd()
+  {
+    TS_ASSERT(points_equal(double_and_add(THREE, SECP256K1_GENERATOR), GENERATOR_TIMES_THREE));
+    TS_ASSERT(point_is_infinity(double_and_add(SECP256K1_ORDER, SECP256K1_GENERATOR)));
+    TS_ASSERT(point_is_infinity(double_and_add(ZERO, SECP256K1_GENERATOR)));
+
+    secp256k1_scalar k = ONE_TRILLION;
+    secp256k1_point a = double_and_add(k, SECP256K1_GENERATOR);
+    secp256k1_point b = double_and_add(scalar_add(k, ONE), SECP256K1_GENERATOR);
+    TS_ASSERT(point_is_on_curve(a));
+    TS_ASSERT(points_equal(point_add(a, SECP256K1_GENERATOR), b));
+  }
+
+  void testPointMultiplesAndBatchAdd()
+  {
+    const size_t n = 9;
+    std::vector<secp256k1_point> table(n), res(n);
+    std::vector<secp256k1_scalar> scratch(2*n);
+    point_multiples(table.data(), SECP256K1_GENERATOR, n);
+    TS_ASSERT(points_equal(table[2], GENERATOR_TIMES_THREE));
+
+    secp256k1_point base = double_and_add(ONE_MILLION, SECP256K1_GENERATOR);
+    point_add_batch(res.data(), base, table.data(), n, scratch.data());
+    for(size_t i = 0; i < n; i++)
+    {
+      secp256k1_point ref = double_and_add(scalar_add(ONE_MILLION, scalar_from_uint64(i + 1)), SECP256K1_GENERATOR);
+      TS_ASSERT(points_equal(res[i], ref));
+    }
+
+    // base collides with table entries: 2G + G, 2G + 2G, 2G + 3G
+    point_add_batch(res.data(), GENERATOR_TIMES_TWO, table.data(), 3, scratch.data());
+    TS_ASSERT(points_equal(res[0], GENERATOR_TIMES_THREE));
+    TS_ASSERT(points_equal(res[1], double_and_add(scalar_from_uint64(4), SECP256K1_GENERATOR)));
+  }
+
+  void testDecompress()
+  {
+    secp256k1_key_compressed key;
+    key.bytes[0] = 0x02 | (SECP256K1_GENERATOR.y.d[7] & 1);
+    for(int i = 0; i < 32; i++)
+    {
+      key.bytes[1 + i] = SECP256K1_GENERATOR.x.d[i / 4] >> (24 - 8 * (i % 4));
+    }
+    secp256k1_point p;
+    TS_ASSERT(point_decompress(p, key));
+    TS_ASSERT(points_equal(p, SECP256K1_GENERATOR));
+
+    key.bytes[0] ^= 1;
+    TS_ASSERT(point_decompress(p, key));
+    TS_ASSERT_EQUALS(p.y, field_neg(SECP256K1_GENERATOR.y));
+
+    key.bytes[0] = 0x04;
+    TS_ASSERT(!point_decompress(p, key));
+  }
+
+  void testSerializeMatchesByteOrder()
+  {
+    secp256k1_point pts[2] = {SECP256K1_GENERATOR, GENERATOR_TIMES_TWO};
+    secp256k1_key_compressed c[2];
+    secp256k1_key_uncompressed u[2];
+    serialize_compressed(c, pts, 2);
+    serialize_uncompressed(u, pts, 2);
+
+    for(int k = 0; k < 2; k++)
+    {
+      TS_ASSERT_EQUALS(c[k].bytes[0], 0x02 | (pts[k].y.d[7] & 1));
+      TS_ASSERT_EQUALS(u[k].bytes[0], 0x04);
+      for(int i = 0; i < 32; i++)
+      {
+        unsigned char xb = pts[k].x.d[i / 4] >> (24 - 8 * (i % 4));
+        unsigned char yb = pts[k].y.d[i / 4] >> (24 - 8 * (i % 4));
+        TS_ASSERT_EQUALS(c[k].bytes[1 + i], xb);
+        TS_ASSERT_EQUALS(u[k].bytes[1 + i], xb);
+        TS_ASSERT_EQUALS(u[k].bytes[33 + i], yb);
+      }
+    }
+    // G and 2G both have an even y
+    TS_ASSERT_EQUALS(c[0].bytes[0], 0x02);
+    TS_ASSERT_EQUALS(c[1].bytes[0], 0x02);
+
+    secp256k1_point back;
+    TS_ASSERT(point_decompress(back, c[1]));
+    TS_ASSERT(points_equal(back, GENERATOR_TIMES_TWO));
+  }
+
+  // BATCH DERIVATION TESTS
+
+  void testGeneratorMultMatchesDoubleAndAdd()
+  {
+    secp256k1_scalar n_minus_one = SECP256K1_ORDER;
+    n_minus_one.d[7] -= 1;
+    secp256k1_scalar top = {0x80000000, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<secp256k1_scalar> keys = {{0, 0, 0, 0, 0, 0, 0, 1}, {0, 0, 0, 0, 0, 0, 0, 0x100}, top, n_minus_one};
+    std::mt19937 rng(17);
+    for(int i = 0; i < 8; i++)
+    {
+      keys.push_back(random_field(rng));
+    }
+
+    for(const secp256k1_scalar &k : keys)
+    {
+      TS_ASSERT(points_equal(generator_mult(k), double_and_add(k, SECP256K1_GENERATOR)));
+    }
+  }
+
+  void testDerivePubkeysMatchesPerKey()
+  {
+    // more keys than one inversion chunk, over several threads
+    std::mt19937 rng(18);
+    std::vector<secp256k1_scalar> keys(2500);
+    for(secp256k1_scalar &k : keys)
+    {
+      k = random_field(rng);
+    }
+    std::vector<secp256k1_key_compressed> c(keys.size());
+    std::vector<secp256k1_key_uncompressed> u(keys.size());
+    derive_pubkeys_compressed(c.data(), keys.data(), keys.size(), 3);
+    derive_pubkeys_uncompressed(u.data(), keys.data(), keys.size(), 1);
+
+    for(size_t i = 0; i < keys.size(); i += 97)
+    {
+      secp256k1_point ref = double_and_add(keys[i], SECP256K1_GENERATOR);
+      secp256k1_key_compressed rc;
+      secp256k1_key_uncompressed ru;
+      serialize_compressed(&rc, &ref, 1);
+      serialize_uncompressed(&ru, &ref, 1);
+      TS_ASSERT_SAME_DATA(c[i].bytes, rc.bytes, sizeof(rc.bytes));
+      TS_ASSERT_SAME_DATA(u[i].bytes, ru.bytes, sizeof(ru.bytes));
+    }
+
+    keys[1234] = SECP256K1_ORDER;
+    TS_ASSERT_THROWS_ANYTHING(derive_pubkeys_compressed(c.data(), keys.data(), keys.size(), 2));
+    keys[1234] = secp256k1_scalar();
+    TS_ASSERT_THROWS_ANYTHING(derive_pubkeys_compressed(c.data(), keys.data(), keys.size(), 2));
+    keys[1234] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+    TS_ASSERT_THROWS_ANYTHING(derive_pubkeys_compressed(c.data(), keys.data(), keys.size(), 2));
+    keys[1234] = SECP256K1_ORDER;
+    keys[1234].d[7] -= 1;
+    derive_pubkeys_compressed(c.data(), keys.data(), keys.size(), 2);
+  }
+
+  void testGeneratorMultAddBatchCoversDoublingAndCancel()
+  {
+    std::mt19937 rng(19);
+    secp256k1_scalar k = random_field(rng);
+    secp256k1_point kg = double_and_add(k, SECP256K1_GENERATOR);
+    secp256k1_point neg = {kg.x, field_neg(kg.y)};
+    secp256k1_point other = double_and_add(random_field(rng), SECP256K1_GENERATOR);
+
+    // tG equal to p, cancelling p, zero, and a generic pair
+    secp256k1_point p[4] = {kg, neg, other, other};
+    secp256k1_scalar t[4] = {k, k, secp256k1_scalar(), random_field(rng)};
+    secp256k1_point r[4];
+    secp256k1_point_jacobian acc[4];
+    secp256k1_scalar scratch[8];
+    generator_mult_add_batch(r, p, t, 4, acc, scratch);
+
+    TS_ASSERT(points_equal(r[0], point_doubling(kg)));
+    TS_ASSERT(point_is_infinity(r[1]));
+    TS_ASSERT(points_equal(r[2], other));
+    TS_ASSERT(points_equal(r[3], point_add(other, double_and_add(t[3], SECP256K1_GENERATOR))));
+  }
+
+  void testDerivePubkeysFile()
+  {
+    std::string in = "/tmp/derive_in_" + std::to_string(getpid());
+    std::string out = in + ".pub";
+    std::vector<unsigned char> bytes;
+    for(uint32_t i = 1; i <= 300; i++)
+    {
+      unsigned char k[32] = {0};
+      k[1] = i & 0xFF;
+      k[2] = i >> 8;
+      k[31] = 7;
+      bytes.insert(bytes.end(), k, k + 32);
+    }
+    FILE * f = fopen(in.c_str(), "wb");
+    fwrite(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+
+    TS_ASSERT_EQUALS(derive_pubkeys_file(in, out, true, 2), 300u);
+    std::vector<unsigned char> pub(300 * 33 + 1);
+    f = fopen(out.c_str(), "rb");
+    TS_ASSERT_EQUALS(fread(pub.data(), 1, pub.size(), f), 300u * 33);
+    fclose(f);
+    remove(in.c_str());
+    remove(out.c_str());
+
+    // key 299: bytes 1 and 2 are 0x2B, 0x01
+    secp256k1_scalar k = {0x002B0100, 0, 0, 0, 0, 0, 0, 7};
+    secp256k1_point ref = double_and_add(k, SECP256K1_GENERATOR);
+    secp256k1_key_compressed rc;
+    serialize_compressed(&rc, &ref, 1);
+    TS_ASSERT_SAME_DATA(pub.data() + 298 * 33, rc.bytes, 33);
+  }
+
+  // POLICY TESTS
+
+  void testLeadingZerosAtEveryPosition()
+  {
+    for(int bit = 0; bit < 512; bit++)
+    {
+      secp256k1_mult_result x = secp256k1_mult_result();
+      x.d[bit / 32] = 0x80000000u >> (bit % 32);
+      x.d[15] |= 1;
+      TS_ASSERT_EQUALS(lzcount(x), bit);
+    }
+  }
+
+  void testConstTimeFieldMatchesVarTime()
+  {
+    secp256k1_scalar p_minus_one = SECP256K1_P;
+    p_minus_one.d[7] -= 1;
+    std::vector<secp256k1_scalar> values = {ZERO, ONE, p_minus_one, SECP256K1_ORDER};
+    std::mt19937 rng(40);
+    for(int i = 0; i < 12; i++)
+    {
+      values.push_back(random_field(rng));
+    }
+
+    for(const secp256k1_scalar &a : values)
+    {
+      for(const secp256k1_scalar &b : values)
+      {
+        TS_ASSERT_EQUALS(mult<const_time>(a, b), mult<var_time>(a, b));
+        TS_ASSERT_EQUALS(field_add<const_time>(a, b), field_add<var_time>(a, b));
+        TS_ASSERT_EQUALS(field_sub<const_time>(a, b), field_sub<var_time>(a, b));
+        TS_ASSERT_EQUALS(field_mul<const_time>(a, b), field_mul<var_time>(a, b));
+      }
+      TS_ASSERT_EQUALS(field_neg<const_time>(a), field_neg<var_time>(a));
+      TS_ASSERT_EQUALS(field_sqr<const_time>(a), field_sqr<var_time>(a));
+      TS_ASSERT_EQUALS(field_pow<const_time>(a, values.back()), field_pow<var_time>(a, values.back()));
+      if (!(a == ZERO)) {
+        TS_ASSERT_EQUALS(field_inv<const_time>(a), field_inv<var_time>(a));
+        TS_ASSERT_EQUALS(modinv<const_time>(padto512(a)), modinv<var_time>(padto512(a)));
+      }
+    }
+    TS_ASSERT_EQUALS(field_inv<const_time>(ZERO), ZERO);
+  }
+
+  void testConstTimeReductionMatchesVarTime()
+  {
+    std::mt19937 rng(41);
+    std::vector<secp256k1_mult_result> moduli = {padto512(SECP256K1_P), padto512(SECP256K1_ORDER), padto512(ONE)};
+    secp256k1_mult_result wide = secp256k1_mult_result();
+    wide.d[3] = 0x1234;
+    wide.d[15] = 77;
+    moduli.push_back(wide);
+    for(int i = 0; i < 20; i++)
+    {
+      secp256k1_mult_result x;
+      for(int j = 0; j < 16; j++)
+      {
+        x.d[j] = rng();
+      }
+      TS_ASSERT_EQUALS(reduce<const_time>(x), reduce<var_time>(x));
+      TS_ASSERT_EQUALS(fastreduce<const_time>(x), fastreduce<var_time>(x));
+      for(const secp256k1_mult_result &m : moduli)
+      {
+        TS_ASSERT_EQUALS(mod<const_time>(x, m), mod<var_time>(x, m));
+      }
+    }
+    TS_ASSERT_EQUALS(reduce<const_time>(MAXpow2), reduce<var_time>(MAXpow2));
+  }
+
+  void testConstTimeScalarMatchesVarTime()
+  {
+    secp256k1_scalar n_minus_one = SECP256K1_ORDER;
+    n_minus_one.d[7] -= 1;
+    std::mt19937 rng(42);
+    secp256k1_scalar r = random_field(rng);
+    TS_ASSERT_EQUALS(scalar_add<const_time>(n_minus_one, ONE), ZERO);
+    TS_ASSERT_EQUALS(scalar_add<const_time>(r, n_minus_one), scalar_add<var_time>(r, n_minus_one));
+    for(uint32_t flag = 0; flag < 2; flag++)
+    {
+      TS_ASSERT_EQUALS(scalar_cond_neg<const_time>(r, flag), scalar_cond_neg<var_time>(r, flag));
+      TS_ASSERT_EQUALS(scalar_cond_neg<const_time>(ZERO, flag), ZERO);
+    }
+    TS_ASSERT_EQUALS(scalar_add<const_time>(scalar_cond_neg<const_time>(r, 1), r), ZERO);
+  }
+
+  void testConstTimePointsMatchVarTime()
+  {
+    secp256k1_scalar n_minus_one = SECP256K1_ORDER;
+    n_minus_one.d[7] -= 1;
+    std::mt19937 rng(43);
+    std::vector<secp256k1_scalar> keys = {ZERO, ONE, scalar_from_uint64(2), n_minus_one, random_field(rng), random_field(rng)};
+    for(const secp256k1_scalar &k : keys)
+    {
+      TS_ASSERT(points_equal(double_and_add<const_time>(k, SECP256K1_GENERATOR), double_and_add<var_time>(k, SECP256K1_GENERATOR)));
+    }
+
+    // every special case of the mixed addition: either side infinite, equal and opposite points
+    secp256k1_point p = double_and_add(random_field(rng), SECP256K1_GENERATOR);
+    secp256k1_point q = double_and_add(random_field(rng), SECP256K1_GENERATOR);
+    secp256k1_point neg = {p.x, field_neg(p.y)};
+    secp256k1_point_jacobian pj = jacobian_double(jacobian_from_affine(p));
+    secp256k1_point p2 = jacobian_to_affine(pj);
+    std::vector<secp256k1_point> others = {SECP256K1_INFINITY, p, neg, q, p2, {p2.x, field_neg(p2.y)}};
+    std::vector<secp256k1_point_jacobian> accs = {secp256k1_point_jacobian(), jacobian_from_affine(p), pj};
+    for(const secp256k1_point_jacobian &a : accs)
+    {
+      for(const secp256k1_point &b : others)
+      {
+        TS_ASSERT(points_equal(jacobian_to_affine<const_time>(jacobian_add_affine<const_time>(a, b)),
+          jacobian_to_affine<var_time>(jacobian_add_affine<var_time>(a, b))));
+      }
+      TS_ASSERT(points_equal(jacobian_to_affine<const_time>(jacobian_double<const_time>(a)),
+        jacobian_to_affine<var_time>(jacobian_double<var_time>(a))));
+    }
+    for(const secp256k1_point &a : others)
+    {
+      for(const secp256k1_point &b : others)
+      {
+        TS_ASSERT(points_equal(point_add<const_time>(a, b), point_add<var_time>(a, b)));
+      }
+      TS_ASSERT(points_equal(point_doubling<const_time>(a), point_doubling<var_time>(a)));
+    }
+  }
+
+  void testConstTimeCombMatchesVarTime()
+  {
+    secp256k1_scalar n_minus_one = SECP256K1_ORDER;
+    n_minus_one.d[7] -= 1;
+    // zero bytes, a single byte at either end and the largest key
+    secp256k1_scalar top = {0xff000000, 0, 0, 0, 0, 0, 0, 0};
+    std::mt19937 rng(44);
+    std::vector<secp256k1_scalar> keys = {ONE, scalar_from_uint64(0xff00ff), top, n_minus_one, random_field(rng)};
+    std::vector<secp256k1_point_jacobian> jac;
+    for(const secp256k1_scalar &k : keys)
+    {
+      secp256k1_point p = generator_mult<const_time>(k);
+      TS_ASSERT(points_equal(p, generator_mult<var_time>(k)));
+      jac.push_back(jacobian_double(jacobian_from_affine(p)));
+    }
+
+    // the batch normalisation keeps infinity out of the shared inversion
+    jac.insert(jac.begin() + 2, secp256k1_point_jacobian());
+    std::vector<secp256k1_point> ct(jac.size()), vt(jac.size());
+    std::vector<secp256k1_scalar> scratch(2 * jac.size());
+    jacobian_batch_to_affine<const_time>(ct.data(), jac.data(), jac.size(), scratch.data());
+    jacobian_batch_to_affine<var_time>(vt.data(), jac.data(), jac.size(), scratch.data());
+    for(size_t i = 0; i < jac.size(); i++)
+    {
+      TS_ASSERT(points_equal(ct[i], vt[i]));
+    }
+    TS_ASSERT(point_is_infinity(ct[2]));
+  }
+
+  // SEED GENERATOR TESTS
+
+  void testAesStreamKnownAnswer()
+  {
+    // FIPS-197 C.1: the first counter block is the plaintext
+    unsigned char seed[AES_STREAM_SEED_SIZE];
+    for(int i = 0; i < 16; i++)
+    {
+      seed[i] = i;
+      seed[16 + i] = (i << 4) | i;
+    }
+    const unsigned char expected[16] = {
+      0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a
+    };
+
+    aes_stream s;
+    aes_stream_seed(s, seed);
+    unsigned char out[16];
+    aes_stream_fill(s, out, 16);
+    TS_ASSERT_SAME_DATA(out, expected, 16);
+  }
+
+  void testAesStreamBulkMatchesBlockwise()
+  {
+    aes_stream a, b;
+    aes_stream_seed_deterministic(a, 42, 1);
+    aes_stream_seed_deterministic(b, 42, 1);
+
+    unsigned char bulk[300], small[300];
+    aes_stream_fill(a, bulk, sizeof(bulk));
+    for(size_t i = 0; i < sizeof(small); i += 20)
+    {
+      aes_stream_fill(b, small + i, 20);
+    }
+    // 20 byte reads discard the tail of each block, so only the first block lines up
+    TS_ASSERT_SAME_DATA(bulk, small, 16);
+
+    aes_stream_seed_deterministic(b, 42, 1);
+    for(size_t i = 0; i < sizeof(small); i += 100)
+    {
+      aes_stream_fill(b, small + i, 100 - 100 % 16);
+    }
+    TS_ASSERT_SAME_DATA(bulk, small, 96);
+  }
+
+  void testAesStreamScalarsAreInRange()
+  {
+    aes_stream s;
+    aes_stream_seed_deterministic(s, 1, 0);
+    for(int i = 0; i < 100; i++)
+    {
+      secp256k1_scalar k = aes_stream_scalar(s);
+      TS_ASSERT(k < SECP256K1_ORDER);
+      TS_ASSERT(k > ZERO);
+    }
+  }
+
+  void testAesStreamsAreSeparated()
+  {
+    aes_stream a, b;
+    aes_stream_seed_deterministic(a, 1, 0);
+    aes_stream_seed_deterministic(b, 1, 1);
+    TS_ASSERT(!(aes_stream_scalar(a) == aes_stream_scalar(b)));
+  }
+
 };
@@ -0,0 +1,176 @@
+#include "sha256.h"
+#include <cstring>
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t rotr32(uint32_t x, int k)
+{
+    return (x >> k) | (x << (32 - k));
+}
+
+static inline uint32_t load_be32(const unsigned char * p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline void store_be32(unsigned char * p, uint32_t v)
+{
+    v = __builtin_bswap32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+void sha256_compress(uint32_t h[8], const unsigned char block[SHA256_BLOCK_SIZE])
+{
+    uint32_t w[64];
+    for(int i = 0; i < 16; i++) {
+        w[i] = load_be32(block + 4*i);
+    }
+    for(int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for(int i = 0; i < 64; i++) {
+        uint32_t t1 = k + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+// Same compression over SHA256_LANES states at once, every step is an
+// independent loop over the lanes so that it maps onto 8 x 32-bit vectors
+void sha256_compress_x8(uint32_t h[8][SHA256_LANES], const uint32_t win[16][SHA256_LANES])
+{
+    uint32_t w[64][SHA256_LANES];
+    memcpy(w, win, sizeof(uint32_t) * 16 * SHA256_LANES);
+    for(int i = 16; i < 64; i++) {
+        for(int l = 0; l < SHA256_LANES; l++) {
+            uint32_t s0 = rotr32(w[i - 15][l], 7) ^ rotr32(w[i - 15][l], 18) ^ (w[i - 15][l] >> 3);
+            uint32_t s1 = rotr32(w[i - 2][l], 17) ^ rotr32(w[i - 2][l], 19) ^ (w[i - 2][l] >> 10);
+            w[i][l] = w[i - 16][l] + s0 + w[i - 7][l] + s1;
+        }
+    }
+
+    uint32_t s[8][SHA256_LANES];
+    memcpy(s, h, sizeof(s));
+    for(int i = 0; i < 64; i++) {
+        for(int l = 0; l < SHA256_LANES; l++) {
+            uint32_t a = s[0][l], b = s[1][l], c = s[2][l], e = s[4][l], f = s[5][l], g = s[6][l];
+            uint32_t t1 = s[7][l] + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g))
+                + SHA256_K[i] + w[i][l];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            s[7][l] = g;
+            s[6][l] = f;
+            s[5][l] = e;
+            s[4][l] = s[3][l] + t1;
+            s[3][l] = c;
+            s[2][l] = b;
+            s[1][l] = a;
+            s[0][l] = t1 + t2;
+        }
+    }
+    for(int i = 0; i < 8; i++) {
+        for(int l = 0; l < SHA256_LANES; l++) {
+            h[i][l] += s[i][l];
+        }
+    }
+}
+
+// absorbs in and pads, prefix is the length already compressed into h
+static void sha256_finish(unsigned char out[32], uint32_t h[8], const unsigned char * in, size_t len, uint64_t prefix)
+{
+    uint64_t bits = (prefix + len) * 8;
+    for(; len >= (size_t)SHA256_BLOCK_SIZE; in += SHA256_BLOCK_SIZE, len -= SHA256_BLOCK_SIZE) {
+        sha256_compress(h, in);
+    }
+
+    unsigned char block[2 * SHA256_BLOCK_SIZE] = {0};
+    memcpy(block, in, len);
+    block[len] = 0x80;
+    size_t padded = len + 9 <= (size_t)SHA256_BLOCK_SIZE ? SHA256_BLOCK_SIZE : 2 * SHA256_BLOCK_SIZE;
+    for(int i = 0; i < 8; i++) {
+        block[padded - 1 - i] = bits >> (8 * i);
+    }
+    sha256_compress(h, block);
+    if (padded > (size_t)SHA256_BLOCK_SIZE) {
+        sha256_compress(h, block + SHA256_BLOCK_SIZE);
+    }
+
+    for(int i = 0; i < 8; i++) {
+        store_be32(out + 4*i, h[i]);
+    }
+}
+
+void sha256(unsigned char out[32], const unsigned char * in, size_t len)
+{
+    uint32_t h[8];
+    memcpy(h, SHA256_IV, sizeof(h));
+    sha256_finish(out, h, in, len, 0);
+}
+
+sha256_midstate sha256_tagged_midstate(const std::string &tag)
+{
+    unsigned char block[SHA256_BLOCK_SIZE];
+    sha256(block, (const unsigned char *)tag.data(), tag.size());
+    memcpy(block + 32, block, 32);
+
+    sha256_midstate mid;
+    memcpy(mid.h, SHA256_IV, sizeof(mid.h));
+    sha256_compress(mid.h, block);
+    return mid;
+}
+
+void sha256_tagged(unsigned char out[32], const sha256_midstate &mid, const unsigned char * in, size_t len)
+{
+    uint32_t h[8];
+    memcpy(h, mid.h, sizeof(h));
+    sha256_finish(out, h, in, len, SHA256_BLOCK_SIZE);
+}
+
+// the message and its padding fill the second block: 0x80 after the 32 bytes
+// and a total length of 96 bytes
+void sha256_tagged32_x8(uint32_t out[8][SHA256_LANES], const sha256_midstate &mid, const uint32_t in[8][SHA256_LANES])
+{
+    uint32_t w[16][SHA256_LANES];
+    memcpy(w, in, sizeof(uint32_t) * 8 * SHA256_LANES);
+    for(int l = 0; l < SHA256_LANES; l++) {
+        w[8][l] = 0x80000000;
+        for(int i = 9; i < 15; i++) {
+            w[i][l] = 0;
+        }
+        w[15][l] = (SHA256_BLOCK_SIZE + 32) * 8;
+    }
+
+    for(int i = 0; i < 8; i++) {
+        for(int l = 0; l < SHA256_LANES; l++) {
+            out[i][l] = mid.h[i];
+        }
+    }
+    sha256_compress_x8(out, w);
+}
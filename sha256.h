@@ -0,0 +1,34 @@
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#ifndef SHA256_H
+#define SHA256_H
+
+// SHA-256 (FIPS 180-4) and the BIP340 tagged hashes built on it
+const int SHA256_BLOCK_SIZE = 64;
+
+// number of independent states compressed together by sha256_compress_x8
+const int SHA256_LANES = 8;
+
+struct sha256_midstate
+{
+    uint32_t h[8];
+};
+
+void sha256_compress(uint32_t h[8], const unsigned char block[SHA256_BLOCK_SIZE]);
+// lane-interleaved states and message words: h[i][l] is word i of state l
+void sha256_compress_x8(uint32_t h[8][SHA256_LANES], const uint32_t w[16][SHA256_LANES]);
+void sha256(unsigned char out[32], const unsigned char * in, size_t len);
+
+// H_tag(m) = SHA256(SHA256(tag) || SHA256(tag) || m). The prefix is exactly one
+// block, so its state is computed once per tag and every hash starts from there.
+sha256_midstate sha256_tagged_midstate(const std::string &tag);
+void sha256_tagged(unsigned char out[32], const sha256_midstate &mid, const unsigned char * in, size_t len);
+
+// SHA256_LANES tagged hashes of 32 byte messages at one compression each.
+// Messages and digests are big-endian 32-bit words, the limb order of
+// secp256k1_scalar, so x coordinates go in and scalars come out without byte swapping.
+void sha256_tagged32_x8(uint32_t out[8][SHA256_LANES], const sha256_midstate &mid, const uint32_t in[8][SHA256_LANES]);
+
+#endif
@@ -0,0 +1,78 @@
+#include "splitkey.h"
+#include "keysearch.h"
+#include "search.h"
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+static secp256k1_scalar worker_offset(const secp256k1_scalar &start, int worker)
+{
+    secp256k1_scalar region = secp256k1_scalar();
+    region.d[1] = worker;
+    return scalar_add<const_time>(start, region);
+}
+
+splitkey_result splitkey_search(const secp256k1_key_compressed &customer, const eth_pattern &p,
+    int nthreads, const secp256k1_scalar &start, size_t batch, checkpoint_publisher * checkpoint, result_sink * sink)
+{
+    secp256k1_point q;
+    if (!point_decompress(q, customer)) {
+        throw new std::runtime_error("Customer key is not a valid compressed point");
+    }
+
+    // table[i] = (i + 1)G, shared read-only by all workers
+    std::vector<secp256k1_point> table(batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, batch);
+
+    splitkey_result res = splitkey_result();
+    std::mutex res_lock;
+    search_control ctl;
+
+    search_run(nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        checkpoint_worker state = checkpoint_worker();
+        if (!checkpoint_resume(checkpoint, worker, state)) {
+            state.base = worker_offset(start, worker);
+        }
+        secp256k1_scalar offset = scalar_add<const_time>(state.base, scalar_from_uint64(state.steps));
+        secp256k1_point base = point_add<const_time>(q, double_and_add<const_time>(offset, SECP256K1_GENERATOR));
+
+        keysearch_walker w;
+        keysearch_walker_init(w, table.data(), batch);
+        keysearch_hit hit;
+        while (!ctl.stop) {
+            uint64_t from = state.steps;
+            uint64_t n = keysearch_walk(w, base, p, ctl, KEYSEARCH_CHUNK_STEPS, hit);
+            base = w.last;
+            state.steps += n;
+            state.attempts += n;
+            if (checkpoint) {
+                checkpoint_publish(*checkpoint, worker, state);
+            }
+            if (sink && result_sink_full(*sink)) {
+                ctl.stop = true;
+            }
+            if (!hit.found) {
+                continue;
+            }
+
+            secp256k1_scalar found = scalar_add<const_time>(state.base, scalar_from_uint64(from + hit.step + 1));
+            if (sink) {
+                result_record rec = {found, 0, hit.address};
+                if (result_sink_push(*sink, worker, rec)) {
+                    ctl.stop = true;
+                }
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(res_lock);
+            if (!res.found) {
+                res.found = true;
+                res.offset = found;
+                res.point = hit.point;
+                res.address = hit.address;
+            }
+            ctl.stop = true;
+        }
+    });
+    return res;
+}
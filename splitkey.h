@@ -0,0 +1,29 @@
+#include <cstddef>
+#include "secp256k1.h"
+#include "ethaddress.h"
+#include "checkpoint.h"
+#include "resultsink.h"
+
+#ifndef SPLITKEY_H
+#define SPLITKEY_H
+
+// Split-key search: the customer keeps the secret s of Q = sG and we only
+// ever see Q. We walk Q + kG and hand back the offset k, the customer's
+// private key for the found address is s + k mod n.
+struct splitkey_result
+{
+    bool found;
+    secp256k1_scalar offset;
+    secp256k1_point point;
+    eth_address address;
+};
+
+// Each worker starts at its own offset start + (worker << 192) and steps by
+// batch points per shared inversion. With a checkpoint publisher the workers
+// publish their base offset and steps, and a resumed run continues from those
+// instead of start. With a sink every hit goes there and the search runs on
+// until the sink's limit.
+splitkey_result splitkey_search(const secp256k1_key_compressed &customer, const eth_pattern &p,
+    int nthreads, const secp256k1_scalar &start, size_t batch, checkpoint_publisher * checkpoint, result_sink * sink);
+
+#endif
@@ -0,0 +1,244 @@
+#include "stats.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+thread_local stats_thread * stats_current = nullptr;
+
+static const char * STATS_STAGE_NAMES[STATS_STAGE_COUNT] = {
+    "step", "inversion", "serialize", "hash", "tweak"
+};
+
+stats_registry &stats_global()
+{
+    static stats_registry registry;
+    return registry;
+}
+
+void stats_reset(int nthreads)
+{
+    stats_registry &reg = stats_global();
+    if (nthreads > STATS_MAX_THREADS) {
+        nthreads = STATS_MAX_THREADS;
+    }
+    for(int i = 0; i < STATS_MAX_THREADS; i++)
+    {
+        reg.threads[i].keys = 0;
+        for(int s = 0; s < STATS_STAGE_COUNT; s++)
+        {
+            reg.threads[i].cycles[s] = 0;
+        }
+    }
+    reg.nthreads = nthreads;
+}
+
+void stats_bind_thread(int worker)
+{
+    stats_current = worker < STATS_MAX_THREADS ? &stats_global().threads[worker] : nullptr;
+}
+
+void stats_take_snapshot(stats_snapshot &s)
+{
+    stats_registry &reg = stats_global();
+    s.nthreads = reg.nthreads;
+    s.time = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    for(int i = 0; i < s.nthreads; i++)
+    {
+        s.keys[i] = reg.threads[i].keys.load(std::memory_order_relaxed);
+        for(int st = 0; st < STATS_STAGE_COUNT; st++)
+        {
+            s.cycles[i][st] = reg.threads[i].cycles[st].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string stats_format_prometheus(const stats_snapshot &cur, const stats_snapshot &prev, double probability)
+{
+    std::string out;
+    char line[256];
+    double dt = cur.time - prev.time;
+    bool same_search = prev.nthreads == cur.nthreads;
+
+    uint64_t total = 0;
+    double rate = 0;
+    uint64_t stage_total[STATS_STAGE_COUNT] = {0};
+
+    out += "# HELP vanity_keys_total Keys checked per worker thread.\n";
+    out += "# TYPE vanity_keys_total counter\n";
+    for(int i = 0; i < cur.nthreads; i++)
+    {
+        snprintf(line, sizeof(line), "vanity_keys_total{thread=\"%d\"} %llu\n", i, (unsigned long long)cur.keys[i]);
+        out += line;
+        total += cur.keys[i];
+        for(int st = 0; st < STATS_STAGE_COUNT; st++)
+        {
+            stage_total[st] += cur.cycles[i][st];
+        }
+    }
+
+    out += "# HELP vanity_keys_per_second Keys per second per worker thread over the last interval.\n";
+    out += "# TYPE vanity_keys_per_second gauge\n";
+    for(int i = 0; i < cur.nthreads; i++)
+    {
+        uint64_t before = same_search && cur.keys[i] >= prev.keys[i] ? prev.keys[i] : 0;
+        double r = dt > 0 ? (cur.keys[i] - before) / dt : 0;
+        rate += r;
+        snprintf(line, sizeof(line), "vanity_keys_per_second{thread=\"%d\"} %.1f\n", i, r);
+        out += line;
+    }
+
+#ifdef VANITY_STATS
+    out += "# HELP vanity_stage_cycles_total TSC cycles spent per pipeline stage.\n";
+    out += "# TYPE vanity_stage_cycles_total counter\n";
+    for(int i = 0; i < cur.nthreads; i++)
+    {
+        for(int st = 0; st < STATS_STAGE_COUNT; st++)
+        {
+            snprintf(line, sizeof(line), "vanity_stage_cycles_total{thread=\"%d\",stage=\"%s\"} %llu\n",
+                i, STATS_STAGE_NAMES[st], (unsigned long long)cur.cycles[i][st]);
+            out += line;
+        }
+    }
+
+    uint64_t busy = stage_total[STATS_STAGE_STEP] + stage_total[STATS_STAGE_SERIALIZE] + stage_total[STATS_STAGE_HASH]
+        + stage_total[STATS_STAGE_TWEAK];
+    out += "# HELP vanity_batch_inversion_share Fraction of timed cycles spent in the batch inversion.\n";
+    out += "# TYPE vanity_batch_inversion_share gauge\n";
+    snprintf(line, sizeof(line), "vanity_batch_inversion_share %.4f\n",
+        busy ? (double)stage_total[STATS_STAGE_INVERSION] / busy : 0.0);
+    out += line;
+#else
+    (void)stage_total;
+    (void)STATS_STAGE_NAMES;
+#endif
+
+    if (probability > 0) {
+        // attempts are memoryless, the expected remaining work is always 1/p
+        double success = -std::expm1(total * std::log1p(-probability));
+        out += "# HELP vanity_success_probability Chance that a match had been found by now.\n";
+        out += "# TYPE vanity_success_probability gauge\n";
+        snprintf(line, sizeof(line), "vanity_success_probability %.6f\n", success);
+        out += line;
+
+        out += "# HELP vanity_eta_seconds Expected seconds to the next match at the current rate.\n";
+        out += "# TYPE vanity_eta_seconds gauge\n";
+        snprintf(line, sizeof(line), "vanity_eta_seconds %.1f\n", rate > 0 ? 1.0 / probability / rate : INFINITY);
+        out += line;
+    }
+    return out;
+}
+
+static void write_file_atomic(const std::string &path, const std::string &text)
+{
+    std::string tmp = path + ".tmp";
+    FILE * f = fopen(tmp.c_str(), "w");
+    if (!f) {
+        return;
+    }
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+    rename(tmp.c_str(), path.c_str());
+}
+
+static int open_unix_socket(const std::string &path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_un addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void reporter_loop(stats_reporter &r)
+{
+    const std::string unix_prefix = "unix:";
+    bool to_socket = r.opt.target.compare(0, unix_prefix.size(), unix_prefix) == 0;
+    std::string socket_path = to_socket ? r.opt.target.substr(unix_prefix.size()) : "";
+    int listen_fd = to_socket ? open_unix_socket(socket_path) : -1;
+    if (to_socket && listen_fd < 0) {
+        std::cerr << "stats: could not listen on " << socket_path << std::endl;
+    }
+
+    // snapshots are large, keep them off the stack
+    std::unique_ptr<stats_snapshot> prev(new stats_snapshot());
+    std::unique_ptr<stats_snapshot> cur(new stats_snapshot());
+    stats_take_snapshot(*prev);
+    std::string latest = stats_format_prometheus(*prev, *prev, r.opt.probability);
+
+    auto next = std::chrono::steady_clock::now() + std::chrono::duration<double>(r.opt.interval);
+    while (!r.stop) {
+        // wake up often enough to notice stop and to serve socket clients
+        pollfd pfd = {listen_fd, POLLIN, 0};
+        if (listen_fd >= 0) {
+            poll(&pfd, 1, 100);
+        } else {
+            usleep(100 * 1000);
+        }
+
+        if (listen_fd >= 0 && (pfd.revents & POLLIN)) {
+            int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0) {
+                ssize_t ignored = write(client, latest.data(), latest.size());
+                (void)ignored;
+                close(client);
+            }
+        }
+
+        if (std::chrono::steady_clock::now() < next) {
+            continue;
+        }
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(r.opt.interval));
+
+        stats_take_snapshot(*cur);
+        latest = stats_format_prometheus(*cur, *prev, r.opt.probability);
+        std::swap(prev, cur);
+
+        if (to_socket) {
+            continue;
+        } else if (r.opt.target == "-" || r.opt.target.empty()) {
+            std::cerr << latest << std::flush;
+        } else {
+            write_file_atomic(r.opt.target, latest);
+        }
+    }
+
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+}
+
+void stats_reporter_start(stats_reporter &r, const stats_report_options &opt)
+{
+    r.opt = opt;
+    r.stop = false;
+    r.thread = std::thread(reporter_loop, std::ref(r));
+}
+
+void stats_reporter_stop(stats_reporter &r)
+{
+    r.stop = true;
+    if (r.thread.joinable()) {
+        r.thread.join();
+    }
+}
+
+stats_reporter::~stats_reporter()
+{
+    stats_reporter_stop(*this);
+}
@@ -0,0 +1,103 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#ifdef VANITY_STATS
+#include <x86intrin.h>
+#endif
+
+#ifndef STATS_H
+#define STATS_H
+
+// Hot path counters. Every worker thread owns one cache line and is its only
+// writer, a reporter thread reads them with relaxed loads.
+// Key counts are always kept, the rdtsc stage timers only exist when built
+// with -DVANITY_STATS (make STATS=1).
+enum stats_stage
+{
+    STATS_STAGE_STEP,       // batched point addition, including the inversion
+    STATS_STAGE_INVERSION,  // the shared batch inversion alone
+    STATS_STAGE_SERIALIZE,
+    STATS_STAGE_HASH,       // hashing and matching
+    STATS_STAGE_TWEAK,      // taproot P + tG, including its inversion
+    STATS_STAGE_COUNT
+};
+
+const int STATS_MAX_THREADS = 256;
+
+struct alignas(64) stats_thread
+{
+    std::atomic<uint64_t> keys;
+    std::atomic<uint64_t> cycles[STATS_STAGE_COUNT];
+};
+
+struct stats_registry
+{
+    std::atomic<int> nthreads;
+    stats_thread threads[STATS_MAX_THREADS];
+};
+
+// the process-wide registry, search_run binds its workers to the first slots
+stats_registry &stats_global();
+void stats_reset(int nthreads);
+void stats_bind_thread(int worker);
+
+extern thread_local stats_thread * stats_current;
+
+static inline void stats_add(std::atomic<uint64_t> &counter, uint64_t n)
+{
+    // single writer, a plain load and store avoids the locked add
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline void stats_count_keys(uint64_t n)
+{
+    if (stats_current) {
+        stats_add(stats_current->keys, n);
+    }
+}
+
+#ifdef VANITY_STATS
+#define STATS_TIMER_START(name) uint64_t name = __rdtsc()
+#define STATS_TIMER_STOP(name, stage) \
+    do { if (stats_current) stats_add(stats_current->cycles[stage], __rdtsc() - name); } while (0)
+#else
+#define STATS_TIMER_START(name) do {} while (0)
+#define STATS_TIMER_STOP(name, stage) do {} while (0)
+#endif
+
+struct stats_snapshot
+{
+    int nthreads;
+    double time;
+    uint64_t keys[STATS_MAX_THREADS];
+    uint64_t cycles[STATS_MAX_THREADS][STATS_STAGE_COUNT];
+};
+
+void stats_take_snapshot(stats_snapshot &s);
+// Prometheus text exposition format. probability is the chance that a single
+// key matches, 0 leaves out the ETA.
+std::string stats_format_prometheus(const stats_snapshot &cur, const stats_snapshot &prev, double probability);
+
+// target is "-" for stderr, "unix:<path>" to serve the latest report on a
+// Unix socket, anything else is a file that is replaced atomically
+struct stats_report_options
+{
+    double interval;
+    std::string target;
+    double probability;
+};
+
+struct stats_reporter
+{
+    stats_report_options opt;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    ~stats_reporter();
+};
+
+void stats_reporter_start(stats_reporter &r, const stats_report_options &opt);
+void stats_reporter_stop(stats_reporter &r);
+
+#endif
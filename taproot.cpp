@@ -0,0 +1,338 @@
+#include "taproot.h"
+#include "aesctr.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+static const char BECH32_CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+// BIP350 checksum constant, bech32 (v0) uses 1
+static const uint32_t BECH32M_CONST = 0x2bc830a3;
+static const char TAPROOT_HRP[] = "bc";
+
+static int bech32_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        c += 'a' - 'A';
+    }
+    for(int i = 0; i < 32; i++)
+    {
+        if (BECH32_CHARSET[i] == c) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+taproot_pattern taproot_pattern_compile(const std::string &pattern)
+{
+    taproot_pattern p = taproot_pattern();
+    size_t start = 0;
+    if (pattern.size() >= 4 && bech32_value(pattern[3]) == 1
+        && (pattern.compare(0, 3, "bc1") == 0 || pattern.compare(0, 3, "BC1") == 0)) {
+        start = 4;
+    }
+
+    if (pattern.size() - start > (size_t)TAPROOT_PATTERN_MAX_CHARS) {
+        throw new std::runtime_error("Pattern is longer than the part of the address the key decides");
+    }
+
+    for(size_t i = start; i < pattern.size(); i++)
+    {
+        int v = bech32_value(pattern[i]);
+        if (v < 0) {
+            throw new std::runtime_error("Pattern contains a character outside the bech32 alphabet");
+        }
+
+        // character n covers bits 5n .. 5n + 4 of x, counted from the top
+        int n = p.nchars++;
+        for(int b = 0; b < 5; b++)
+        {
+            int bit = 5 * n + b;
+            uint32_t m = (uint32_t)1 << (31 - bit % 32);
+            p.mask.d[bit / 32] |= m;
+            if ((v >> (4 - b)) & 1) {
+                p.value.d[bit / 32] |= m;
+            }
+        }
+    }
+    return p;
+}
+
+double taproot_pattern_probability(const taproot_pattern &p)
+{
+    double prob = 1;
+    for(int i = 0; i < p.nchars; i++)
+    {
+        prob /= 32;
+    }
+    return prob;
+}
+
+static uint32_t bech32_polymod(const unsigned char * v, size_t n)
+{
+    static const uint32_t gen[5] = {0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3};
+    uint32_t chk = 1;
+    for(size_t i = 0; i < n; i++)
+    {
+        uint32_t top = chk >> 25;
+        chk = ((chk & 0x1ffffff) << 5) ^ v[i];
+        for(int j = 0; j < 5; j++)
+        {
+            if ((top >> j) & 1) {
+                chk ^= gen[j];
+            }
+        }
+    }
+    return chk;
+}
+
+std::string taproot_address(const secp256k1_scalar &qx)
+{
+    // expanded hrp, the witness version, 52 groups of x and room for the checksum
+    const size_t hrp_len = sizeof(TAPROOT_HRP) - 1;
+    unsigned char v[2 * hrp_len + 1 + 1 + 52 + 6] = {0};
+    size_t n = 0;
+    for(size_t i = 0; i < hrp_len; i++)
+    {
+        v[n++] = TAPROOT_HRP[i] >> 5;
+    }
+    v[n++] = 0;
+    for(size_t i = 0; i < hrp_len; i++)
+    {
+        v[n++] = TAPROOT_HRP[i] & 31;
+    }
+    size_t data = n;
+    v[n++] = 1;
+    for(int g = 0; g < 52; g++)
+    {
+        int group = 0;
+        for(int b = 0; b < 5; b++)
+        {
+            int bit = 5 * g + b;
+            group <<= 1;
+            if (bit < 256) {
+                group |= (qx.d[bit / 32] >> (31 - bit % 32)) & 1;
+            }
+        }
+        v[n++] = group;
+    }
+
+    uint32_t chk = bech32_polymod(v, n + 6) ^ BECH32M_CONST;
+    for(int i = 0; i < 6; i++)
+    {
+        v[n + i] = (chk >> (5 * (5 - i))) & 31;
+    }
+
+    std::string res = std::string(TAPROOT_HRP) + "1";
+    for(size_t i = data; i < n + 6; i++)
+    {
+        res += BECH32_CHARSET[v[i]];
+    }
+    return res;
+}
+
+const sha256_midstate &taproot_tweak_midstate()
+{
+    static const sha256_midstate mid = sha256_tagged_midstate("TapTweak");
+    return mid;
+}
+
+secp256k1_scalar taproot_tweak(const secp256k1_scalar &px)
+{
+    unsigned char x[32];
+    unsigned char h[32];
+    for(int i = 0; i < 32; i++)
+    {
+        x[i] = px.d[i / 4] >> (24 - 8 * (i % 4));
+    }
+    sha256_tagged(h, taproot_tweak_midstate(), x, sizeof(x));
+
+    secp256k1_scalar t;
+    for(int i = 0; i < 8; i++)
+    {
+        t.d[i] = (uint32_t)h[4*i] << 24 | (uint32_t)h[4*i + 1] << 16 | (uint32_t)h[4*i + 2] << 8 | h[4*i + 3];
+    }
+    return t;
+}
+
+static inline bool y_is_odd(const secp256k1_point &a)
+{
+    return a.y.d[7] & 1;
+}
+
+bool taproot_output_key(secp256k1_point &q, const secp256k1_point &p)
+{
+    secp256k1_scalar t = taproot_tweak(p.x);
+    if (!(t < SECP256K1_ORDER)) {
+        return false;
+    }
+    secp256k1_point even = p;
+    if (y_is_odd(even)) {
+        even.y = field_neg(even.y);
+    }
+    q = point_add(even, double_and_add(t, SECP256K1_GENERATOR));
+    return !point_is_infinity(q);
+}
+
+secp256k1_scalar taproot_output_secret(const secp256k1_scalar &d)
+{
+    secp256k1_point p = double_and_add<const_time>(d, SECP256K1_GENERATOR);
+    secp256k1_scalar k = scalar_cond_neg<const_time>(d, p.y.d[7] & 1);
+    return scalar_add<const_time>(k, taproot_tweak(p.x));
+}
+
+void taproot_walker_init(taproot_walker &w, const secp256k1_point * table, size_t batch)
+{
+    w.table = table;
+    w.batch = batch;
+    arena_init(w.mem, 3 * arena_bytes<secp256k1_point>(batch) + arena_bytes<secp256k1_scalar>(batch)
+        + arena_bytes<secp256k1_point_jacobian>(batch) + arena_bytes<secp256k1_scalar>(2 * batch));
+    w.points = arena_array<secp256k1_point>(w.mem, batch);
+    w.even = arena_array<secp256k1_point>(w.mem, batch);
+    w.tweaks = arena_array<secp256k1_scalar>(w.mem, batch);
+    w.outputs = arena_array<secp256k1_point>(w.mem, batch);
+    w.acc = arena_array<secp256k1_point_jacobian>(w.mem, batch);
+    w.scratch = arena_array<secp256k1_scalar>(w.mem, 2 * batch);
+}
+
+// tweaks for the whole batch, SHA256_LANES x coordinates per hash call
+static void tweak_batch(taproot_walker &w)
+{
+    const sha256_midstate &mid = taproot_tweak_midstate();
+    uint32_t in[8][SHA256_LANES] = {};
+    uint32_t out[8][SHA256_LANES];
+    for(size_t j = 0; j < w.batch; j += SHA256_LANES)
+    {
+        size_t lanes = std::min<size_t>(SHA256_LANES, w.batch - j);
+        for(int i = 0; i < 8; i++)
+        {
+            for(size_t l = 0; l < lanes; l++) {
+                in[i][l] = w.points[j + l].x.d[i];
+            }
+        }
+        sha256_tagged32_x8(out, mid, in);
+        for(size_t l = 0; l < lanes; l++)
+        {
+            secp256k1_scalar &t = w.tweaks[j + l];
+            for(int i = 0; i < 8; i++) {
+                t.d[i] = out[i][l];
+            }
+            // out of range (p < 2^-127), such a candidate is rejected on the generic path
+            if (!(t < SECP256K1_ORDER)) {
+                t = secp256k1_scalar();
+            }
+        }
+    }
+}
+
+uint64_t taproot_walk(taproot_walker &w, const secp256k1_point &start, const taproot_pattern &p,
+    search_control &ctl, uint64_t max_steps, taproot_hit &hit)
+{
+    secp256k1_point base = start;
+    uint64_t steps = 0;
+    hit.found = false;
+
+    while (steps < max_steps && !ctl.stop) {
+        STATS_TIMER_START(t_step);
+        point_add_batch(w.points, base, w.table, w.batch, w.scratch);
+        STATS_TIMER_STOP(t_step, STATS_STAGE_STEP);
+
+        STATS_TIMER_START(t_hash);
+        tweak_batch(w);
+        STATS_TIMER_STOP(t_hash, STATS_STAGE_HASH);
+
+        STATS_TIMER_START(t_tweak);
+        for(size_t i = 0; i < w.batch; i++)
+        {
+            w.even[i] = w.points[i];
+            if (y_is_odd(w.even[i])) {
+                w.even[i].y = field_neg(w.even[i].y);
+            }
+        }
+        generator_mult_add_batch(w.outputs, w.even, w.tweaks, w.batch, w.acc, w.scratch);
+        STATS_TIMER_STOP(t_tweak, STATS_STAGE_TWEAK);
+
+        STATS_TIMER_START(t_match);
+        for(size_t i = 0; i < w.batch; i++)
+        {
+            if (!taproot_match(p, w.outputs[i].x)) {
+                continue;
+            }
+            secp256k1_point q;
+            if (!taproot_output_key(q, w.points[i]) || !(q.x == w.outputs[i].x)) {
+                continue;
+            }
+            STATS_TIMER_STOP(t_match, STATS_STAGE_HASH);
+            hit.found = true;
+            hit.step = steps + i;
+            hit.internal = w.points[i];
+            hit.output = q;
+            w.last = w.points[i];
+            search_count(ctl, i + 1);
+            return steps + i + 1;
+        }
+        STATS_TIMER_STOP(t_match, STATS_STAGE_HASH);
+
+        base = w.points[w.batch - 1];
+        steps += w.batch;
+        search_count(ctl, w.batch);
+    }
+    w.last = base;
+    return steps;
+}
+
+taproot_options taproot_default_options()
+{
+    taproot_options opt = taproot_options();
+    opt.nthreads = search_default_threads();
+    opt.batch = 256;
+    opt.reseed_steps = (uint64_t)1 << 32;
+    opt.deterministic_seed = 0;
+    return opt;
+}
+
+taproot_result taproot_search(const taproot_pattern &p, const taproot_options &opt)
+{
+    std::vector<secp256k1_point> table(opt.batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, opt.batch);
+    // built here so the threads do not all wait on the first use
+    generator_mult(scalar_from_uint64(1));
+
+    taproot_result res = taproot_result();
+    std::mutex res_lock;
+    search_control ctl;
+
+    search_run(opt.nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        aes_stream rng;
+        if (opt.deterministic_seed) {
+            aes_stream_seed_deterministic(rng, opt.deterministic_seed, worker);
+        } else {
+            aes_stream_seed_random(rng);
+        }
+
+        taproot_walker w;
+        taproot_walker_init(w, table.data(), opt.batch);
+        taproot_hit hit;
+
+        while (!ctl.stop) {
+            secp256k1_scalar base = aes_stream_scalar(rng);
+            secp256k1_point start = double_and_add<const_time>(base, SECP256K1_GENERATOR);
+            uint64_t n = taproot_walk(w, start, p, ctl, opt.reseed_steps, hit);
+            if (!hit.found) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(res_lock);
+            if (!res.found) {
+                res.found = true;
+                res.private_key = scalar_add<const_time>(base, scalar_from_uint64(n));
+                res.internal = hit.internal;
+                res.output = hit.output;
+                res.address = taproot_address(hit.output.x);
+            }
+            ctl.stop = true;
+        }
+    });
+    return res;
+}
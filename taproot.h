@@ -0,0 +1,109 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "secp256k1.h"
+#include "sha256.h"
+#include "search.h"
+#include "arena.h"
+
+#ifndef TAPROOT_H
+#define TAPROOT_H
+
+// Taproot (BIP340/341/86) key-path addresses: the internal key P is used
+// x-only with even y, t = H_TapTweak(P.x) and the output key is Q = P + tG.
+// The address is the bech32m encoding of witness version 1 and Q.x, so the
+// characters after "bc1p" are Q.x read 5 bits at a time from the top.
+
+// data characters after "bc1p" that only depend on Q.x, the 52nd holds its last bit
+const int TAPROOT_PATTERN_MAX_CHARS = 51;
+
+struct taproot_pattern
+{
+    secp256k1_scalar value;
+    secp256k1_scalar mask;
+    int nchars;
+};
+
+// "bc1p" is optional, letters may be of either case
+taproot_pattern taproot_pattern_compile(const std::string &pattern);
+// chance that one output key matches, 32^-nchars
+double taproot_pattern_probability(const taproot_pattern &p);
+
+inline bool taproot_match(const taproot_pattern &p, const secp256k1_scalar &qx)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        if ((qx.d[i] & p.mask.d[i]) != p.value.d[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// bech32m "bc1p..." address of an output key
+std::string taproot_address(const secp256k1_scalar &qx);
+
+const sha256_midstate &taproot_tweak_midstate();
+// int(H_TapTweak(px)), without script tree
+secp256k1_scalar taproot_tweak(const secp256k1_scalar &px);
+// Q for the internal key p, false if the tweak is not below the group order
+bool taproot_output_key(secp256k1_point &q, const secp256k1_point &p);
+// secret of the output key for the internal secret d, d negated for an odd y of dG, plus t
+secp256k1_scalar taproot_output_secret(const secp256k1_scalar &d);
+
+struct taproot_hit
+{
+    bool found;
+    uint64_t step;
+    secp256k1_point internal;
+    secp256k1_point output;
+};
+
+// Per-thread buffers, carved from one arena like the keysearch walker
+struct taproot_walker
+{
+    const secp256k1_point * table;
+    size_t batch;
+    arena mem;
+    // internal keys as walked, then with y made even
+    secp256k1_point * points;
+    secp256k1_point * even;
+    secp256k1_scalar * tweaks;
+    secp256k1_point * outputs;
+    secp256k1_point_jacobian * acc;
+    secp256k1_scalar * scratch;
+    secp256k1_point last;
+};
+
+void taproot_walker_init(taproot_walker &w, const secp256k1_point * table, size_t batch);
+
+// Walks internal keys start + G, start + 2G, ... until an output key matches,
+// ctl.stop or max_steps (rounded up to whole batches). Per batch: one affine
+// step of the walk, SHA256_LANES tweaks per hash call and the batched P + tG.
+uint64_t taproot_walk(taproot_walker &w, const secp256k1_point &start, const taproot_pattern &p,
+    search_control &ctl, uint64_t max_steps, taproot_hit &hit);
+
+struct taproot_options
+{
+    int nthreads;
+    size_t batch;
+    // steps walked from one random seed before drawing a new one
+    uint64_t reseed_steps;
+    // 0 seeds every thread from getrandom(), otherwise streams are reproducible
+    uint64_t deterministic_seed;
+};
+
+// private_key is the internal secret, as imported into a tr(KEY) descriptor
+struct taproot_result
+{
+    bool found;
+    secp256k1_scalar private_key;
+    secp256k1_point internal;
+    secp256k1_point output;
+    std::string address;
+};
+
+taproot_options taproot_default_options();
+taproot_result taproot_search(const taproot_pattern &p, const taproot_options &opt);
+
+#endif
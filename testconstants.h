@@ -85,4 +85,18 @@ const secp256k1_mult_result MAXpow2 = {
     0x00000000,0x00000000,0x00000000,0x00000000,
     0x00000000,0x00000000,0x00000000,0x00000001
 };
+
+const secp256k1_point GENERATOR_TIMES_TWO = {
+    {0xC6047F94,0x41ED7D6D,0x3045406E,0x95C07CD8,
+    0x5C778E4B,0x8CEF3CA7,0xABAC09B9,0x5C709EE5},
+    {0x1AE168FE,0xA63DC339,0xA3C58419,0x466CEAEE,
+    0xF7F63265,0x3266D0E1,0x236431A9,0x50CFE52A}
+};
+
+const secp256k1_point GENERATOR_TIMES_THREE = {
+    {0xF9308A01,0x9258C310,0x49344F85,0xF89D5229,
+    0xB531C845,0x836F99B0,0x8601F113,0xBCE036F9},
+    {0x388F7B0F,0x632DE814,0x0FE337E6,0x2A37F356,
+    0x6500A999,0x34C2231B,0x6CB9FD75,0x84B8E672}
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "tune.h"
+#include "aesctr.h"
+#include "ethaddress.h"
+#include "keysearch.h"
+#include "search.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+static const size_t TUNE_BATCHES[] = {64, 128, 256, 512, 1024, 2048};
+
+double tune_measure(int nthreads, size_t batch, double seconds)
+{
+    std::vector<secp256k1_point> table(batch);
+    point_multiples(table.data(), SECP256K1_GENERATOR, batch);
+    // 40 nibbles, never matches in practice
+    eth_pattern p = eth_pattern_compile(std::string(40, '0'), false);
+
+    search_control ctl;
+    std::thread timer([&]() {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        ctl.stop = true;
+    });
+
+    auto t0 = std::chrono::steady_clock::now();
+    search_run(nthreads, ctl, [&](int worker, int nworkers, search_control &ctl) {
+        aes_stream rng;
+        aes_stream_seed_deterministic(rng, 1, worker);
+        keysearch_walker w;
+        keysearch_walker_init(w, table.data(), batch);
+        keysearch_hit hit;
+        secp256k1_point start = double_and_add(aes_stream_scalar(rng), SECP256K1_GENERATOR);
+        keysearch_walk(w, start, p, ctl, UINT64_MAX, hit);
+    });
+    timer.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return ctl.attempts / s;
+}
+
+// The batch size is tuned on one thread first, then thread counts from one to
+// twice the core count (for SMT machines where the count is off) with that batch.
+tune_result tune_run(double seconds_per_trial)
+{
+    tune_result best = {1, TUNE_BATCHES[0], 0};
+    for(size_t batch : TUNE_BATCHES)
+    {
+        double rate = tune_measure(1, batch, seconds_per_trial);
+        if (rate > best.keys_per_sec) {
+            best.batch = batch;
+            best.keys_per_sec = rate;
+        }
+    }
+
+    int cores = search_default_threads();
+    std::vector<int> counts = {1};
+    for(int t = 2; t < cores; t *= 2)
+    {
+        counts.push_back(t);
+    }
+    if (cores > 1) {
+        counts.push_back(cores);
+        counts.push_back(2 * cores);
+    }
+    for(int t : counts)
+    {
+        if (t == 1) {
+            continue;
+        }
+        double rate = tune_measure(t, best.batch, seconds_per_trial);
+        if (rate > best.keys_per_sec) {
+            best.nthreads = t;
+            best.keys_per_sec = rate;
+        }
+    }
+    return best;
+}
+
+std::string tune_cpu_model()
+{
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    std::string model = "unknown";
+    while (std::getline(in, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                model = line.substr(colon + 2);
+            }
+            break;
+        }
+    }
+    // the same model can come with different core counts
+    return model + " x" + std::to_string(search_default_threads());
+}
+
+std::string tune_cache_path()
+{
+    const char * xdg = getenv("XDG_CACHE_HOME");
+    const char * home = getenv("HOME");
+    std::string dir = xdg ? xdg : (home ? std::string(home) + "/.cache" : "/tmp");
+    return dir + "/ec-vanity-address-tune";
+}
+
+// one line per model: threads<TAB>batch<TAB>keys_per_sec<TAB>model
+bool tune_load(tune_result &r, const std::string &path, const std::string &model)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        tune_result t;
+        std::string name;
+        if (!(fields >> t.nthreads >> t.batch >> t.keys_per_sec)) {
+            continue;
+        }
+        fields.get();
+        std::getline(fields, name);
+        if (name == model && t.nthreads > 0 && t.batch > 0) {
+            r = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+void tune_save(const tune_result &r, const std::string &path, const std::string &model)
+{
+    std::vector<std::string> keep;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.rfind('\t');
+        if (tab != std::string::npos && line.substr(tab + 1) != model) {
+            keep.push_back(line);
+        }
+    }
+    in.close();
+
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp);
+    for(const std::string &l : keep)
+    {
+        out << l << "\n";
+    }
+    out << r.nthreads << "\t" << r.batch << "\t" << r.keys_per_sec << "\t" << model << "\n";
+    out.close();
+    rename(tmp.c_str(), path.c_str());
+}
+
+tune_result tune_cached(bool retune, double seconds_per_trial)
+{
+    std::string model = tune_cpu_model();
+    std::string path = tune_cache_path();
+    tune_result r;
+    if (!retune && tune_load(r, path, model)) {
+        return r;
+    }
+    r = tune_run(seconds_per_trial);
+    tune_save(r, path, model);
+    return r;
+}
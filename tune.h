@@ -0,0 +1,28 @@
+#include <cstddef>
+#include <string>
+
+#ifndef TUNE_H
+#define TUNE_H
+
+// Startup autotuning of the key search: batch size (which is both the batch
+// inversion size and the step table size) and thread count, cached per CPU model.
+struct tune_result
+{
+    int nthreads;
+    size_t batch;
+    double keys_per_sec;
+};
+
+// keys/s of the batched walk with a pattern that never matches
+double tune_measure(int nthreads, size_t batch, double seconds);
+tune_result tune_run(double seconds_per_trial);
+
+std::string tune_cpu_model();
+std::string tune_cache_path();
+bool tune_load(tune_result &r, const std::string &path, const std::string &model);
+void tune_save(const tune_result &r, const std::string &path, const std::string &model);
+
+// cached result for this machine, or a fresh tuning run that is then cached
+tune_result tune_cached(bool retune, double seconds_per_trial);
+
+#endif